@@ -0,0 +1,105 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2012 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+
+// Compares stripHtmlTags from src/utility with the implementation it
+// replaced on a page resembling the ones lyrics fetchers receive.
+//
+// usage: html_benchmark [size of the page in KB, 720 by default]
+
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+
+#include "utility/html.h"
+
+namespace {//
+
+void oldReplace(std::string &s, const std::string &from, const std::string &to)
+{
+	for (size_t i = 0; (i = s.find(from, i)) != std::string::npos; i += to.length())
+		s.replace(i, from.length(), to);
+}
+
+void oldStripHtmlTags(std::string &s)
+{
+	bool erase = 0;
+	for (size_t i = s.find("<"); i != std::string::npos; i = s.find("<"))
+	{
+		size_t j = s.find(">", i)+1;
+		s.replace(i, j-i, "");
+	}
+	oldReplace(s, "&#039;", "'");
+	oldReplace(s, "&amp;", "&");
+	oldReplace(s, "&quot;", "\"");
+	oldReplace(s, "&nbsp;", " ");
+	for (size_t i = 0; i < s.length(); ++i)
+	{
+		if (erase)
+		{
+			s.erase(s.begin()+i);
+			erase = 0;
+		}
+		if (s[i] == 13)
+		{
+			s[i] = '\n';
+			erase = 1;
+		}
+		else if (s[i] == '\t')
+			s[i] = ' ';
+	}
+}
+
+std::string makePage(size_t size)
+{
+	const std::string line = "<span class=\"line\">Don&#039;t stop &amp; "
+		"&quot;listen&quot;&nbsp;to\tthe music</span><br />\r\n";
+	std::string page = "<html><head><title>Artist &amp; Title</title></head><body>\r\n";
+	while (page.length() < size)
+		page += line;
+	page += "</body></html>\r\n";
+	return page;
+}
+
+double measure(void (*strip)(std::string &), const std::string &page, std::string &result)
+{
+	result = page;
+	clock_t start = clock();
+	strip(result);
+	return double(clock()-start)*1000/CLOCKS_PER_SEC;
+}
+
+}
+
+int main(int argc, char **argv)
+{
+	size_t size = (argc > 1 ? atoi(argv[1]) : 720)*1024;
+	std::string page = makePage(size), old_result, new_result;
+	
+	double old_time = measure(oldStripHtmlTags, page, old_result);
+	double new_time = measure(stripHtmlTags, page, new_result);
+	
+	std::cout << "page size:  " << page.length()/1024 << "KB\n";
+	std::cout << "old:        " << old_time << "ms\n";
+	std::cout << "new:        " << new_time << "ms\n";
+	std::cout << "same result: " << (old_result == new_result ? "yes" : "no") << "\n";
+	return 0;
+}
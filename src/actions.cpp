@@ -27,6 +27,7 @@
 #include "actions.h"
 #include "charset.h"
 #include "config.h"
+#include "directory_tree.h"
 #include "display.h"
 #include "global.h"
 #include "mpdpp.h"
@@ -946,6 +947,7 @@ void SavePlaylist::Run()
 			}
 		}
 	}
+	DatabaseTree.clear("/");
 	if (!myBrowser->isLocal()
 	&&  myBrowser->CurrentDir() == "/"
 	&&  !myBrowser->main().empty())
@@ -1556,7 +1558,10 @@ void EditPlaylistName::Run()
 			const char msg[] = "Playlist renamed to \"%ls\"";
 			Statusbar::msg(msg, wideShorten(ToWString(new_name), COLS-const_strlen(msg)).c_str());
 			if (!myBrowser->isLocal())
+			{
+				DatabaseTree.clear("/");
 				myBrowser->GetDirectory("/");
+			}
 		}
 	}
 }
@@ -2062,7 +2067,10 @@ void AddRandomItems::Run()
 	Statusbar::put() << "Number of random " << tag_type_str << "s: ";
 	size_t number = stringToLongInt(wFooter->getString());
 	Statusbar::unlock();
-	if (number && (answer == 's' ? Mpd.AddRandomSongs(number) : Mpd.AddRandomTag(tag_type, number)))
+	unsigned half_life = Config.random_items_recency_half_life;
+	if (number && (answer == 's'
+	               ? Mpd.AddRandomSongs(number, half_life)
+	               : Mpd.AddRandomTag(tag_type, number, half_life)))
 		Statusbar::msg("%zu random %s%s added to playlist", number, tag_type_str.c_str(), number == 1 ? "" : "s");
 }
 
@@ -2076,13 +2084,9 @@ void ToggleBrowserSortMode::Run()
 	switch (Config.browser_sort_mode)
 	{
 		case smName:
-			if (!myBrowser->isLocal())
-			{
-				Config.browser_sort_mode = smMTime;
-				Statusbar::msg("Sort songs by: Modification time");
-				break;
-			}
-		// local browser doesn't support sorting by mtime, so we just skip it.
+			Config.browser_sort_mode = smMTime;
+			Statusbar::msg("Sort songs by: Modification time");
+			break;
 		case smMTime:
 			Config.browser_sort_mode = smCustomFormat;
 			Statusbar::msg("Sort songs by: Custom format");
@@ -2125,15 +2129,12 @@ void ToggleLibraryTagType::Run()
 		myLibrary->Tags.setTitle(Config.titles_visibility ? item_type + "s" : "");
 		myLibrary->Tags.reset();
 		item_type = lowercase(item_type);
-		std::string and_mtime = Config.media_library_sort_by_mtime ?
-			                    " and mtime" :
-								"";
 		if (myLibrary->Columns() == 2)
 		{
 			myLibrary->Songs.clear();
 			myLibrary->Albums.reset();
 			myLibrary->Albums.clear();
-			myLibrary->Albums.setTitle(Config.titles_visibility ? "Albums (sorted by " + item_type + and_mtime + ")" : "");
+			myLibrary->updateAlbumsTitle();
 			myLibrary->Albums.display();
 		}
 		else
@@ -2535,6 +2536,17 @@ void ToggleMediaLibraryMTimeSort::Run()
 		myLibrary->toggleMTimeSort();
 }
 
+bool ToggleMediaLibraryRecentlyAdded::canBeRun() const
+{
+	return myScreen == myLibrary;
+}
+
+void ToggleMediaLibraryRecentlyAdded::Run()
+{
+	myLibrary->toggleRecentlyAdded();
+	myLibrary->refresh();
+}
+
 
 namespace {//
 
@@ -2660,6 +2672,7 @@ void populateActions()
 	insertAction(new ShowClock());
 	insertAction(new ShowServerInfo());
 	insertAction(new ToggleMediaLibraryMTimeSort());
+	insertAction(new ToggleMediaLibraryRecentlyAdded());
 }
 
 }
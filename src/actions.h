@@ -48,7 +48,8 @@ enum ActionType
 	aShowSongInfo, aShowArtistInfo,
 	aShowLyrics, aQuit, aNextScreen, aPreviousScreen, aShowHelp, aShowPlaylist, aShowBrowser, aChangeBrowseMode,
 	aShowSearchEngine, aResetSearchEngine, aShowMediaLibrary, aToggleMediaLibraryColumnsMode, aShowPlaylistEditor, aShowTagEditor, aShowOutputs,
-	aShowVisualizer, aShowClock, aShowServerInfo, aToggleMediaLibraryMTimeSort
+	aShowVisualizer, aShowClock, aShowServerInfo, aToggleMediaLibraryMTimeSort,
+	aToggleMediaLibraryRecentlyAdded
 };
 
 struct Action
@@ -1111,4 +1112,12 @@ struct ToggleMediaLibraryMTimeSort : public Action
 	virtual void Run();
 };
 
+struct ToggleMediaLibraryRecentlyAdded : public Action
+{
+	ToggleMediaLibraryRecentlyAdded() : Action(aToggleMediaLibraryRecentlyAdded,
+	                                           "toggle_media_library_recently_added") { }
+	virtual bool canBeRun() const;
+	virtual void Run();
+};
+
 #endif // _ACTIONS_H
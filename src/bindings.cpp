@@ -465,6 +465,8 @@ void BindingsConfiguration::generateDefaults()
 		bind(k, aMoveSelectedItemsUp);
 		bind(k, aToggleMediaLibraryMTimeSort);
 	}
+	if (notBound(k = stringToKey("N")))
+		bind(k, aToggleMediaLibraryRecentlyAdded);
 	if (notBound(k = stringToKey("n")))
 	{
 		bind(k, aMoveSortOrderDown);
@@ -19,13 +19,21 @@
  ***************************************************************************/
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <cassert>
 #include <cerrno>
 #include <cstring>
+#include <ctime>
 #include <algorithm>
+#include <deque>
+#include <map>
 
 #include "browser.h"
 #include "charset.h"
+#include "directory_tree.h"
 #include "display.h"
 #include "global.h"
 #include "helpers.h"
@@ -57,6 +65,12 @@ namespace {//
 std::set<std::string> SupportedExtensions;
 bool hasSupportedExtension(const std::string &file);
 
+#ifndef WIN32
+void readLocalDirectory(const std::string &directory, bool show_hidden,
+                        MPD::ItemList &items, std::vector<std::string> *subdirs);
+bool walkLocalDirectory(const std::string &directory, bool show_hidden, MPD::ItemList &songs);
+#endif // !WIN32
+
 std::string ItemToString(const MPD::Item &item);
 bool BrowserEntryMatcher(const Regex &rx, const MPD::Item &item, bool filter);
 
@@ -90,10 +104,6 @@ void Browser::switchTo()
 {
 	SwitchTo::execute(this);
 	
-	// local browser doesn't support sorting by mtime
-	if (isLocal() && Config.browser_sort_mode == smMTime)
-		Config.browser_sort_mode = smName;
-	
 	if (w.empty())
 		GetDirectory(itsBrowsedDir);
 	else
@@ -172,7 +182,11 @@ void Browser::spacePressed()
 				MPD::SongList list;
 				MPD::ItemList items;
 				Statusbar::msg("Scanning directory \"%s\"...", item.name.c_str());
-				myBrowser->GetLocalDirectory(items, item.name, 1);
+				if (!myBrowser->GetLocalDirectory(items, item.name, 1))
+				{
+					Statusbar::msg("Scanning cancelled");
+					break;
+				}
 				list.reserve(items.size());
 				for (MPD::ItemList::const_iterator it = items.begin(); it != items.end(); ++it)
 					list.push_back(*it->song);
@@ -345,6 +359,57 @@ MPD::SongList Browser::getSelectedSongs()
 	return result;
 }
 
+bool Browser::allowsServerSideAdding()
+{
+	if (isLocal() || w.empty())
+		return false;
+	// playlists can't be loaded within commands list
+	bool any_selected = false;
+	for (auto it = w.begin(); it != w.end(); ++it)
+	{
+		if (it->isSelected())
+		{
+			if (it->value().type == itPlaylist)
+				return false;
+			any_selected = true;
+		}
+	}
+	if (!any_selected)
+	{
+		const MPD::Item &item = w.current().value();
+		return item.type != itPlaylist && !isParentDirectory(item);
+	}
+	return true;
+}
+
+bool Browser::addSelectedSongs(bool play)
+{
+	assert(allowsServerSideAdding());
+	auto item_handler = [](const MPD::Item &item) {
+		if (item.type == itDirectory)
+			Mpd.Add(item.name);
+		else if (item.type == itSong)
+			Mpd.AddSong(*item.song);
+	};
+	size_t position = Mpd.GetPlaylistLength();
+	Mpd.StartCommandsList();
+	bool any_selected = false;
+	for (auto it = w.begin(); it != w.end(); ++it)
+	{
+		if (it->isSelected())
+		{
+			item_handler(it->value());
+			any_selected = true;
+		}
+	}
+	// if no item is selected, add current one
+	if (!any_selected)
+		item_handler(w.current().value());
+	if (play)
+		Mpd.Play(position);
+	return Mpd.CommitCommandsList();
+}
+
 void Browser::LocateSong(const MPD::Song &s)
 {
 	if (s.getDirectory().empty())
@@ -389,20 +454,17 @@ void Browser::GetDirectory(std::string dir, std::string subdir)
 		w.addItem(parent);
 	}
 	
-	MPD::ItemList list;
+	// both lists are already sorted
 #	ifndef WIN32
+	MPD::ItemList local_list;
 	if (isLocal())
-		GetLocalDirectory(list);
-	else
-		list = Mpd.GetDirectory(dir);
+		GetLocalDirectory(local_list);
+	const MPD::ItemList &list = isLocal() ? local_list : DatabaseTree.items(dir);
 #	else
-	list = Mpd.GetDirectory(dir);
+	const MPD::ItemList &list = DatabaseTree.items(dir);
 #	endif // !WIN32
-	if (!isLocal()) // local directory is already sorted
-		std::sort(list.begin(), list.end(),
-			LocaleBasedItemSorting(std::locale(), Config.ignore_leading_the, Config.browser_sort_mode));
 	
-	for (MPD::ItemList::iterator it = list.begin(); it != list.end(); ++it)
+	for (MPD::ItemList::const_iterator it = list.begin(); it != list.end(); ++it)
 	{
 		switch (it->type)
 		{
@@ -439,63 +501,22 @@ void Browser::GetDirectory(std::string dir, std::string subdir)
 }
 
 #ifndef WIN32
-void Browser::GetLocalDirectory(MPD::ItemList &v, const std::string &directory, bool recursively) const
+bool Browser::GetLocalDirectory(MPD::ItemList &v, const std::string &directory, bool recursively) const
 {
-	DIR *dir = opendir((directory.empty() ? itsBrowsedDir : directory).c_str());
-	
-	if (!dir)
-		return;
-	
-	dirent *file;
-	
-	struct stat file_stat;
-	std::string full_path;
+	const std::string &path = directory.empty() ? itsBrowsedDir : directory;
+	if (recursively)
+		return walkLocalDirectory(path, Config.local_browser_show_hidden_files, v);
 	
 	size_t old_size = v.size();
-	while ((file = readdir(dir)))
-	{
-		// omit . and ..
-		if (file->d_name[0] == '.' && (file->d_name[1] == '\0' || (file->d_name[1] == '.' && file->d_name[2] == '\0')))
-			continue;
-		
-		if (!Config.local_browser_show_hidden_files && file->d_name[0] == '.')
-			continue;
-		MPD::Item new_item;
-		full_path = directory.empty() ? itsBrowsedDir : directory;
-		if (itsBrowsedDir != "/")
-			full_path += "/";
-		full_path += file->d_name;
-		stat(full_path.c_str(), &file_stat);
-		if (S_ISDIR(file_stat.st_mode))
-		{
-			if (recursively)
-			{
-				GetLocalDirectory(v, full_path, 1);
-				old_size = v.size();
-			}
-			else
-			{
-				new_item.type = itDirectory;
-				new_item.name = full_path;
-				v.push_back(new_item);
-			}
-		}
-		else if (hasSupportedExtension(file->d_name))
-		{
-			new_item.type = itSong;
-			mpd_pair file_pair = { "file", full_path.c_str() };
-			MPD::MutableSong *s = new MPD::MutableSong(mpd_song_begin(&file_pair));
-			new_item.song = std::shared_ptr<MPD::Song>(s);
-#			ifdef HAVE_TAGLIB_H
-			if (!recursively)
-				Tags::read(*s);
-#			endif // HAVE_TAGLIB_H
-			v.push_back(new_item);
-		}
-	}
-	closedir(dir);
+	readLocalDirectory(path, Config.local_browser_show_hidden_files, v, 0);
+#	ifdef HAVE_TAGLIB_H
+	for (auto it = v.begin()+old_size; it != v.end(); ++it)
+		if (it->type == itSong)
+			Tags::read(static_cast<MPD::MutableSong &>(*it->song));
+#	endif // HAVE_TAGLIB_H
 	std::sort(v.begin()+old_size, v.end(),
 		LocaleBasedItemSorting(std::locale(), Config.ignore_leading_the, Config.browser_sort_mode));
+	return true;
 }
 
 void Browser::ClearDirectory(const std::string &path) const
@@ -587,6 +608,195 @@ bool hasSupportedExtension(const std::string &file)
 	return SupportedExtensions.find(ext) != SupportedExtensions.end();
 }
 
+#ifndef WIN32
+// reads entries of local directory. if subdirs is not null,
+// subdirectories are put there instead of being added to items.
+void readLocalDirectory(const std::string &directory, bool show_hidden,
+                        MPD::ItemList &items, std::vector<std::string> *subdirs)
+{
+	int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+	if (fd < 0)
+		return;
+	DIR *dir = fdopendir(fd);
+	if (!dir)
+	{
+		close(fd);
+		return;
+	}
+	
+	struct stat file_stat;
+	std::string full_path;
+	while (dirent *file = readdir(dir))
+	{
+		// omit . and ..
+		if (file->d_name[0] == '.' && (file->d_name[1] == '\0' || (file->d_name[1] == '.' && file->d_name[2] == '\0')))
+			continue;
+		
+		if (!show_hidden && file->d_name[0] == '.')
+			continue;
+		
+		// skip stat calls (which are slow on network filesystems)
+		// if type of the entry is known and it's not needed.
+		bool is_dir = file->d_type == DT_DIR;
+		if (file->d_type == DT_REG && !hasSupportedExtension(file->d_name))
+			continue;
+		if (!is_dir)
+		{
+			// stat relative to opened directory, so that
+			// the whole path doesn't have to be resolved
+			if (fstatat(fd, file->d_name, &file_stat, 0) != 0)
+				continue;
+			is_dir = S_ISDIR(file_stat.st_mode);
+		}
+		
+		full_path = directory;
+		if (directory != "/")
+			full_path += "/";
+		full_path += file->d_name;
+		if (is_dir)
+		{
+			if (subdirs)
+				subdirs->push_back(full_path);
+			else
+			{
+				MPD::Item new_item;
+				new_item.type = itDirectory;
+				new_item.name = full_path;
+				items.push_back(new_item);
+			}
+		}
+		else if (hasSupportedExtension(file->d_name))
+		{
+			MPD::Item new_item;
+			new_item.type = itSong;
+			mpd_pair file_pair = { "file", full_path.c_str() };
+			MPD::MutableSong *s = new MPD::MutableSong(mpd_song_begin(&file_pair));
+			s->setMTime(file_stat.st_mtime);
+			new_item.song = std::shared_ptr<MPD::Song>(s);
+			items.push_back(new_item);
+		}
+	}
+	// closes fd as well
+	closedir(dir);
+}
+
+// state shared by threads walking directory tree. each of them takes a
+// directory from the queue, reads it and puts its subdirectories back,
+// so that slow directories don't hold up the other ones.
+struct LocalWalk
+{
+	LocalWalk(bool show_hidden) : ShowHidden(show_hidden), Busy(0), Songs(0), Cancelled(false), Finished(0)
+	{
+		pthread_mutex_init(&Lock, 0);
+		pthread_cond_init(&WorkAvailable, 0);
+		pthread_cond_init(&Progress, 0);
+	}
+	~LocalWalk()
+	{
+		pthread_cond_destroy(&Progress);
+		pthread_cond_destroy(&WorkAvailable);
+		pthread_mutex_destroy(&Lock);
+	}
+	
+	static void *worker(void *data);
+	
+	pthread_mutex_t Lock;
+	pthread_cond_t WorkAvailable;
+	pthread_cond_t Progress;
+	
+	bool ShowHidden;
+	std::deque<std::string> Queue;
+	// number of threads that are currently reading a directory
+	size_t Busy;
+	// songs found so far, grouped by directory
+	std::map<std::string, MPD::ItemList> Results;
+	size_t Songs;
+	bool Cancelled;
+	size_t Finished;
+};
+
+void *LocalWalk::worker(void *data)
+{
+	LocalWalk &walk = *static_cast<LocalWalk *>(data);
+	MPD::ItemList items;
+	std::vector<std::string> subdirs;
+	pthread_mutex_lock(&walk.Lock);
+	while (true)
+	{
+		while (walk.Queue.empty() && walk.Busy > 0 && !walk.Cancelled)
+			pthread_cond_wait(&walk.WorkAvailable, &walk.Lock);
+		// queue is empty and nobody can add anything to it
+		if (walk.Queue.empty() || walk.Cancelled)
+			break;
+		std::string directory = walk.Queue.front();
+		walk.Queue.pop_front();
+		++walk.Busy;
+		pthread_mutex_unlock(&walk.Lock);
+		
+		items.clear();
+		subdirs.clear();
+		readLocalDirectory(directory, walk.ShowHidden, items, &subdirs);
+		
+		pthread_mutex_lock(&walk.Lock);
+		walk.Queue.insert(walk.Queue.end(), subdirs.begin(), subdirs.end());
+		walk.Songs += items.size();
+		if (!items.empty())
+			walk.Results[directory].swap(items);
+		--walk.Busy;
+		pthread_cond_broadcast(&walk.WorkAvailable);
+	}
+	++walk.Finished;
+	pthread_cond_signal(&walk.Progress);
+	pthread_mutex_unlock(&walk.Lock);
+	return 0;
+}
+
+// collects songs from directory tree, sorted within each directory. any key
+// pressed meanwhile cancels the scan, in which case nothing is collected.
+bool walkLocalDirectory(const std::string &directory, bool show_hidden, MPD::ItemList &songs)
+{
+	LocalWalk walk(show_hidden);
+	walk.Queue.push_back(directory);
+	
+	// reading directories is mostly waiting for disk or network,
+	// so there are more threads than cores
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t threads_count = std::min(std::max(cores*2, 2L), 16L);
+	std::vector<pthread_t> threads;
+	for (size_t i = 0; i < threads_count; ++i)
+	{
+		pthread_t t;
+		if (pthread_create(&t, 0, LocalWalk::worker, &walk) == 0)
+			threads.push_back(t);
+	}
+	
+	if (threads.empty())
+		LocalWalk::worker(&walk);
+	else
+	{
+		Statusbar::waitForThreads(walk.Lock, walk.Progress, walk.Finished, threads.size(), 200,
+			[&walk, &directory]() {
+				return "Scanning directory \"" + directory + "\"... "
+				     + intTo<std::string>::apply(walk.Songs)
+				     + " song" + (walk.Songs == 1 ? "" : "s") + " found";
+			}, walk.Cancelled);
+		for (auto t = threads.begin(); t != threads.end(); ++t)
+			pthread_join(*t, 0);
+	}
+	if (walk.Cancelled)
+		return false;
+	
+	LocaleBasedItemSorting cmp(std::locale(), Config.ignore_leading_the, Config.browser_sort_mode);
+	songs.reserve(songs.size()+walk.Songs);
+	for (auto it = walk.Results.begin(); it != walk.Results.end(); ++it)
+	{
+		std::sort(it->second.begin(), it->second.end(), cmp);
+		songs.insert(songs.end(), it->second.begin(), it->second.end());
+	}
+	return true;
+}
+#endif // !WIN32
+
 std::string ItemToString(const MPD::Item &item)
 {
 	std::string result;
@@ -62,6 +62,9 @@ struct Browser: Screen<NC::Menu<MPD::Item>>, Filterable, HasSongs, Searchable, T
 	virtual void reverseSelection() OVERRIDE;
 	virtual MPD::SongList getSelectedSongs() OVERRIDE;
 	
+	virtual bool allowsServerSideAdding() OVERRIDE;
+	virtual bool addSelectedSongs(bool play) OVERRIDE;
+	
 	// private members
 	const std::string &CurrentDir() { return itsBrowsedDir; }
 	
@@ -69,7 +72,7 @@ struct Browser: Screen<NC::Menu<MPD::Item>>, Filterable, HasSongs, Searchable, T
 	void LocateSong(const MPD::Song &);
 	void GetDirectory(std::string, std::string = "/");
 #	ifndef WIN32
-	void GetLocalDirectory(MPD::ItemList &, const std::string & = "", bool = 0) const;
+	bool GetLocalDirectory(MPD::ItemList &, const std::string & = "", bool = 0) const;
 	void ClearDirectory(const std::string &) const;
 	void ChangeBrowseMode();
 	bool deleteItem(const MPD::Item &);
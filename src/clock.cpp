@@ -32,6 +32,7 @@
 #include "settings.h"
 #include "status.h"
 #include "statusbar.h"
+#include "timers.h"
 #include "title.h"
 #include "screen_switcher.h"
 
@@ -116,6 +117,7 @@ void Clock::update()
 	}
 	
 	tm *time = localtime(&Global::Timer.tv_sec);
+	Timers::wakeUpAt({ Global::Timer.tv_sec+1, 0 });
 	
 	mask = 0;
 	Set(time->tm_sec % 10, 0);
@@ -26,6 +26,7 @@
 #include "charset.h"
 #include "cmdargs.h"
 #include "config.h"
+#include "lyrics_store.h"
 #include "mpdpp.h"
 #include "settings.h"
 
@@ -120,9 +121,26 @@ void ParseArgv(int argc, char **argv)
 			<< "  -?, --help                show help message\n"
 			<< "  -v, --version             display version information\n"
 			<< "  --now-playing             display now playing song [" << now_playing_format << "]\n"
+			<< "  --import-lyrics           import lyrics files into lyrics store\n"
+			<< "  --export-lyrics           export lyrics from lyrics store into files\n"
 			;
 			exit(0);
 		}
+		else if (!strcmp(argv[i], "--import-lyrics") || !strcmp(argv[i], "--export-lyrics"))
+		{
+			CreateDir(Config.lyrics_directory);
+			if (!LyricsStore::open(Config.lyrics_directory))
+			{
+				std::cerr << "Couldn't open lyrics store in " << Config.lyrics_directory << std::endl;
+				exit(1);
+			}
+			if (!strcmp(argv[i], "--import-lyrics"))
+				std::cout << "Imported lyrics: " << LyricsStore::importFiles(Config.lyrics_directory) << std::endl;
+			else
+				std::cout << "Exported lyrics: " << LyricsStore::exportFiles() << std::endl;
+			LyricsStore::close();
+			exit(0);
+		}
 		
 		if (!Action::ConnectToMPD())
 			exit(1);
@@ -25,31 +25,181 @@
 #include <cstdlib>
 #include <pthread.h>
 
+#include "settings.h"
+
 namespace
 {
+	pthread_key_t abort_flag_key;
+	pthread_key_t handle_key;
+	pthread_once_t init_once = PTHREAD_ONCE_INIT;
+	
+	// dns cache and connections are shared between
+	// all threads, so that requests to the same host
+	// don't need to resolve and connect again.
+	CURLSH *share;
+	pthread_mutex_t share_locks[CURL_LOCK_DATA_LAST];
+	
+	void lock_share(CURL *, curl_lock_data data, curl_lock_access, void *)
+	{
+		pthread_mutex_lock(&share_locks[data]);
+	}
+	
+	void unlock_share(CURL *, curl_lock_data data, void *)
+	{
+		pthread_mutex_unlock(&share_locks[data]);
+	}
+	
+	void cleanup_handle(void *handle)
+	{
+		curl_easy_cleanup(handle);
+	}
+	
+	void init()
+	{
+		curl_global_init(CURL_GLOBAL_ALL);
+		pthread_key_create(&abort_flag_key, 0);
+		pthread_key_create(&handle_key, cleanup_handle);
+		for (size_t i = 0; i < CURL_LOCK_DATA_LAST; ++i)
+			pthread_mutex_init(&share_locks[i], 0);
+		share = curl_share_init();
+		curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lock_share);
+		curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlock_share);
+		curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+		curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#		if LIBCURL_VERSION_NUM >= 0x073900
+		curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#		endif
+	}
+	
+	// each thread reuses its own easy handle, which
+	// keeps connections alive between requests.
+	CURL *get_handle()
+	{
+		CURL *c = static_cast<CURL *>(pthread_getspecific(handle_key));
+		if (c)
+			curl_easy_reset(c);
+		else
+		{
+			c = curl_easy_init();
+			pthread_setspecific(handle_key, c);
+		}
+		return c;
+	}
+	
+	// received data is either appended to the string
+	// or passed to the consumer if there is no string
+	struct Sink
+	{
+		Sink(CURL *handle_) : data(0), handle(handle_), reserved(false), stopped(false) { }
+		
+		std::string *data;
+		std::function<bool(const char *, size_t)> consumer;
+		CURL *handle;
+		bool reserved;
+		bool stopped;
+	};
+	
 	size_t write_data(char *buffer, size_t size, size_t nmemb, void *data)
 	{
 		size_t result = size*nmemb;
-		static_cast<std::string *>(data)->append(buffer, result);
+		Sink *s = static_cast<Sink *>(data);
+		if (!s->data)
+		{
+			if (!s->consumer(buffer, result))
+			{
+				s->stopped = true;
+				return 0;
+			}
+			return result;
+		}
+		if (!s->reserved)
+		{
+			// content length is known after headers are received, so
+			// allocate needed space at once (if the server sent it).
+#			if LIBCURL_VERSION_NUM >= 0x073700
+			curl_off_t length;
+			CURLcode code = curl_easy_getinfo(s->handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length);
+#			else
+			double length;
+			CURLcode code = curl_easy_getinfo(s->handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &length);
+#			endif
+			if (code == CURLE_OK && length > 0 && length < 16*1024*1024)
+				s->data->reserve(s->data->size()+size_t(length));
+			else
+				s->data->reserve(s->data->size()+16*1024);
+			s->reserved = true;
+		}
+		s->data->append(buffer, result);
+		return result;
+	}
+	
+#	if LIBCURL_VERSION_NUM >= 0x072000
+	int check_abort_flag(void *flag, curl_off_t, curl_off_t, curl_off_t, curl_off_t)
+#	else
+	int check_abort_flag(void *flag, double, double, double, double)
+#	endif
+	{
+		return static_cast<const std::atomic<bool> *>(flag)->load();
+	}
+	
+	CURLcode perform_transfer(Sink &sink, const std::string &URL, const std::string &referer, unsigned timeout)
+	{
+		CURL *c = sink.handle;
+		curl_easy_setopt(c, CURLOPT_SHARE, share);
+		curl_easy_setopt(c, CURLOPT_URL, URL.c_str());
+		curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, write_data);
+		curl_easy_setopt(c, CURLOPT_WRITEDATA, &sink);
+		curl_easy_setopt(c, CURLOPT_CONNECTTIMEOUT, timeout);
+		curl_easy_setopt(c, CURLOPT_NOSIGNAL, 1);
+		curl_easy_setopt(c, CURLOPT_USERAGENT, "ncmpcpp " VERSION);
+		curl_easy_setopt(c, CURLOPT_DNS_CACHE_TIMEOUT, 300);
+#		if LIBCURL_VERSION_NUM >= 0x071900
+		curl_easy_setopt(c, CURLOPT_TCP_KEEPALIVE, 1);
+#		endif
+		if (Config.http_compression)
+		{
+			// empty string means all encodings supported by libcurl
+#			if LIBCURL_VERSION_NUM >= 0x071506
+			curl_easy_setopt(c, CURLOPT_ACCEPT_ENCODING, "");
+#			else
+			curl_easy_setopt(c, CURLOPT_ENCODING, "");
+#			endif
+		}
+		if (!referer.empty())
+			curl_easy_setopt(c, CURLOPT_REFERER, referer.c_str());
+		if (void *abort_flag = pthread_getspecific(abort_flag_key))
+		{
+			curl_easy_setopt(c, CURLOPT_NOPROGRESS, 0);
+#			if LIBCURL_VERSION_NUM >= 0x072000
+			curl_easy_setopt(c, CURLOPT_XFERINFOFUNCTION, check_abort_flag);
+			curl_easy_setopt(c, CURLOPT_XFERINFODATA, abort_flag);
+#			else
+			curl_easy_setopt(c, CURLOPT_PROGRESSFUNCTION, check_abort_flag);
+			curl_easy_setopt(c, CURLOPT_PROGRESSDATA, abort_flag);
+#			endif
+		}
+		CURLcode result = curl_easy_perform(c);
+		if (result == CURLE_WRITE_ERROR && sink.stopped)
+			result = CURLE_OK;
 		return result;
 	}
 }
 
 CURLcode Curl::perform(std::string &data, const std::string &URL, const std::string &referer, unsigned timeout)
 {
-	CURLcode result;
-	CURL *c = curl_easy_init();
-	curl_easy_setopt(c, CURLOPT_URL, URL.c_str());
-	curl_easy_setopt(c, CURLOPT_WRITEFUNCTION, write_data);
-	curl_easy_setopt(c, CURLOPT_WRITEDATA, &data);
-	curl_easy_setopt(c, CURLOPT_CONNECTTIMEOUT, timeout);
-	curl_easy_setopt(c, CURLOPT_NOSIGNAL, 1);
-	curl_easy_setopt(c, CURLOPT_USERAGENT, "ncmpcpp " VERSION);
-	if (!referer.empty())
-		curl_easy_setopt(c, CURLOPT_REFERER, referer.c_str());
-	result = curl_easy_perform(c);
-	curl_easy_cleanup(c);
-	return result;
+	pthread_once(&init_once, init);
+	Sink sink(get_handle());
+	sink.data = &data;
+	return perform_transfer(sink, URL, referer, timeout);
+}
+
+CURLcode Curl::perform(std::function<bool(const char *, size_t)> consumer, const std::string &URL,
+                       const std::string &referer, unsigned timeout)
+{
+	pthread_once(&init_once, init);
+	Sink sink(get_handle());
+	sink.consumer = consumer;
+	return perform_transfer(sink, URL, referer, timeout);
 }
 
 std::string Curl::escape(const std::string &s)
@@ -60,5 +210,11 @@ std::string Curl::escape(const std::string &s)
 	return result;
 }
 
+void Curl::setAbortFlag(const std::atomic<bool> *flag)
+{
+	pthread_once(&init_once, init);
+	pthread_setspecific(abort_flag_key, flag);
+}
+
 #endif // HAVE_CURL_CURL_H
 
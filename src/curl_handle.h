@@ -27,6 +27,8 @@
 
 #ifdef HAVE_CURL_CURL_H
 
+#include <atomic>
+#include <functional>
 #include <string>
 #include "curl/curl.h"
 
@@ -34,7 +36,16 @@ namespace Curl
 {
 	CURLcode perform(std::string &data, const std::string &URL, const std::string &referer = "", unsigned timeout = 10);
 	
+	/// passes received data to the consumer as soon as it arrives. if the
+	/// consumer returns false, transfer is stopped and considered successful.
+	CURLcode perform(std::function<bool(const char *, size_t)> consumer, const std::string &URL,
+	                 const std::string &referer = "", unsigned timeout = 10);
+	
 	std::string escape(const std::string &s);
+	
+	/// makes transfers performed by the calling thread abort as
+	/// soon as the flag is set. pass null pointer to unset it.
+	void setAbortFlag(const std::atomic<bool> *flag);
 }
 
 #endif // HAVE_CURL_CURL_H
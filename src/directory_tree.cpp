@@ -0,0 +1,101 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2012 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+
+#include <algorithm>
+
+#include "directory_tree.h"
+#include "utility/comparators.h"
+
+DirectoryTree DatabaseTree;
+
+const MPD::ItemList &DirectoryTree::items(const std::string &path)
+{
+	Node &node = fetch(path);
+	auto sorted = node.Sorted.find(Config.browser_sort_mode);
+	if (sorted == node.Sorted.end())
+	{
+		sorted = node.Sorted.insert(std::make_pair(Config.browser_sort_mode, node.Items)).first;
+		std::sort(sorted->second.begin(), sorted->second.end(),
+			LocaleBasedItemSorting(std::locale(), Config.ignore_leading_the, Config.browser_sort_mode));
+	}
+	return sorted->second;
+}
+
+const MPD::StringList &DirectoryTree::directories(const std::string &path)
+{
+	Node &node = fetch(path);
+	if (!node.HasDirectories)
+	{
+		for (auto it = node.Items.begin(); it != node.Items.end(); ++it)
+			if (it->type == MPD::itDirectory)
+				node.Directories.push_back(it->name);
+		std::sort(node.Directories.begin(), node.Directories.end(),
+			LocaleBasedSorting(std::locale(), Config.ignore_leading_the));
+		node.HasDirectories = true;
+	}
+	return node.Directories;
+}
+
+void DirectoryTree::clear()
+{
+	m_root = Node();
+}
+
+void DirectoryTree::clear(const std::string &path)
+{
+	Node &node = find(path);
+	node.Fetched = false;
+	node.Items.clear();
+	node.Sorted.clear();
+	node.HasDirectories = false;
+	node.Directories.clear();
+}
+
+DirectoryTree::Node &DirectoryTree::find(const std::string &path)
+{
+	Node *node = &m_root;
+	if (path == "/")
+		return *node;
+	size_t begin = 0;
+	while (begin < path.length())
+	{
+		size_t end = path.find('/', begin);
+		if (end == std::string::npos)
+			end = path.length();
+		if (end > begin)
+			node = &node->Children[path.substr(begin, end-begin)];
+		begin = end+1;
+	}
+	return *node;
+}
+
+DirectoryTree::Node &DirectoryTree::fetch(const std::string &path)
+{
+	Node &node = find(path);
+	if (!node.Fetched)
+	{
+		node.Items = Mpd.GetDirectory(path);
+		// don't remember contents if something went wrong,
+		// it will be fetched again next time.
+		node.Fetched = Mpd.Connected();
+	}
+	return node;
+}
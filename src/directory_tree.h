@@ -0,0 +1,72 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2012 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+
+#ifndef _DIRECTORY_TREE_H
+#define _DIRECTORY_TREE_H
+
+#include <map>
+#include "mpdpp.h"
+#include "settings.h"
+
+/// Keeps contents of directories of mpd database that were already
+/// listed (along with their sorted versions), so that going back and
+/// forth between them doesn't require asking mpd and sorting again.
+/// Contents have to be dropped whenever database changes.
+struct DirectoryTree
+{
+	/// @return contents of directory sorted according to current sort mode
+	const MPD::ItemList &items(const std::string &path);
+	
+	/// @return full paths of subdirectories of directory sorted by name
+	const MPD::StringList &directories(const std::string &path);
+	
+	/// drops contents of all directories
+	void clear();
+	
+	/// drops contents of given directory (e.g. root directory
+	/// after list of stored playlists changed)
+	void clear(const std::string &path);
+	
+private:
+	struct Node
+	{
+		Node() : Fetched(false), HasDirectories(false) { }
+		
+		bool Fetched;
+		MPD::ItemList Items;
+		std::map<SortMode, MPD::ItemList> Sorted;
+		
+		bool HasDirectories;
+		MPD::StringList Directories;
+		
+		// subdirectories indexed by their names
+		std::map<std::string, Node> Children;
+	};
+	
+	Node &find(const std::string &path);
+	Node &fetch(const std::string &path);
+	
+	Node m_root;
+};
+
+extern DirectoryTree DatabaseTree;
+
+#endif // _DIRECTORY_TREE_H
@@ -322,6 +322,7 @@ void Help::GetKeybindings()
 	KeyDesc(aEditLibraryTag, "Edit tag (left column)/album (middle/right column)");
 	KeyDesc(aToggleLibraryTagType, "Toggle type of tag used in left column");
 	KeyDesc(aToggleMediaLibraryMTimeSort, "Toggle sorting by mtime");
+	KeyDesc(aToggleMediaLibraryRecentlyAdded, "Show/hide recently added albums");
 	
 	KeysSection("Playlist editor");
 	KeyDesc(aPreviousColumn, "Previous column");
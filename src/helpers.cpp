@@ -23,6 +23,7 @@
 #include "helpers.h"
 #include "playlist.h"
 #include "statusbar.h"
+#include "timers.h"
 
 bool addSongToPlaylist(const MPD::Song &s, bool play, size_t position)
 {
@@ -108,6 +109,9 @@ std::wstring Scroller(const std::wstring &str, size_t &pos, size_t width)
 	
 	if (len > width)
 	{
+		// text moves with each redraw of the header, which happens
+		// every half a second, so main loop has to wake up for it
+		Timers::wakeUpAfter(500);
 		s += L" ** ";
 		len = 0;
 		auto b = s.begin(), e = s.end();
@@ -49,6 +49,11 @@ struct HasSongs
 	virtual bool allowsSelection() = 0;
 	virtual void reverseSelection() = 0;
 	virtual MPD::SongList getSelectedSongs() = 0;
+	
+	// screens that can tell mpd what to add (e.g. whole directories or
+	// albums) instead of sending it uris of all selected songs override these.
+	virtual bool allowsServerSideAdding() { return false; }
+	virtual bool addSelectedSongs(bool) { return false; }
 };
 
 struct HasColumns
@@ -28,11 +28,16 @@
 # include <sys/stat.h>
 #endif // WIN32
 
+#include <algorithm>
 #include <cassert>
 #include <cerrno>
 #include <cstring>
+#include <dirent.h>
 #include <fstream>
 #include <iostream>
+#include <set>
+#include <utime.h>
+#include <vector>
 
 #include "helpers.h"
 #include "charset.h"
@@ -40,15 +45,109 @@
 #include "statusbar.h"
 #include "title.h"
 #include "screen_switcher.h"
+#include "workers.h"
 
 using Global::MainHeight;
 using Global::MainStartY;
 
 Lastfm *myLastfm;
 
+namespace {//
+
+// files that are being downloaded, accessed only by main thread
+std::set<std::string> Downloads;
+
+std::string artistsFolder()
+{
+	return Config.ncmpcpp_directory + "artists";
+}
+
+std::string artistFilename(const std::string &artist)
+{
+	std::string file = lowercase(artist + ".txt");
+	removeInvalidCharsFromFilename(file);
+	return artistsFolder() + "/" + file;
+}
+
+enum class CacheState { Missing, Fresh, Stale };
+
+CacheState cacheState(const std::string &filename)
+{
+	struct stat st;
+	if (stat(filename.c_str(), &st) != 0)
+		return CacheState::Missing;
+	if (Config.lastfm_cache_ttl > 0
+	&&  time(0)-st.st_mtime > time_t(Config.lastfm_cache_ttl)*24*60*60)
+		return CacheState::Stale;
+	return CacheState::Fresh;
+}
+
+// marks the file as recently used. modification time is
+// left intact as it tells when the data was downloaded.
+void touch(const std::string &filename)
+{
+	struct stat st;
+	if (stat(filename.c_str(), &st) == 0)
+	{
+		utimbuf times;
+		times.actime = time(0);
+		times.modtime = st.st_mtime;
+		utime(filename.c_str(), &times);
+	}
+}
+
+// removes least recently used files if there are too many of them
+void evict(const std::string &folder)
+{
+	if (Config.lastfm_cache_size == 0)
+		return;
+	DIR *dir = opendir(folder.c_str());
+	if (!dir)
+		return;
+	std::vector<std::pair<time_t, std::string>> files;
+	while (dirent *file = readdir(dir))
+	{
+		struct stat st;
+		std::string path = folder + "/" + file->d_name;
+		if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+			files.push_back(std::make_pair(std::max(st.st_atime, st.st_mtime), path));
+	}
+	closedir(dir);
+	if (files.size() <= Config.lastfm_cache_size)
+		return;
+	std::sort(files.begin(), files.end());
+	for (size_t i = 0; i < files.size()-Config.lastfm_cache_size; ++i)
+		remove(files[i].second.c_str());
+}
+
+// called from worker threads. only one of them may save given file at once
+// (see Downloads), it's written to a temporary file first and then renamed,
+// so that the main thread never reads a partially written one.
+LastfmService::Result fetchAndSave(LastfmService &service, LastfmService::Args args, const std::string &filename)
+{
+	LastfmService::Result result = service.fetch(args);
+	if (result.first)
+	{
+		std::string tmp = filename + ".tmp";
+		std::ofstream output(tmp.c_str());
+		output << result.second;
+		output.close();
+		if (output.good() && rename(tmp.c_str(), filename.c_str()) == 0)
+			evict(artistsFolder());
+		else
+		{
+			remove(tmp.c_str());
+			Error("couldn't save file \"" << filename << "\"");
+		}
+	}
+	return result;
+}
+
+}
+
 Lastfm::Lastfm()
 : Screen(NC::Scrollpad(0, MainStartY, COLS, MainHeight, "", Config.main_color, NC::brNone))
-, isReadyToTake(0), isDownloadInProgress(0)
+, isDownloadInProgress(0)
 { }
 
 void Lastfm::resize()
@@ -65,20 +164,22 @@ std::wstring Lastfm::title()
 	return itsTitle;
 }
 
-void Lastfm::update()
+void Lastfm::Take(const LastfmService::Result &result)
 {
-	if (isReadyToTake)
-		Take();
-}
-
-void Lastfm::Take()
-{
-	assert(isReadyToTake);
-	pthread_join(itsDownloader, 0);
+	if (result.first)
+	{
+		std::string data = result.second;
+		w.clear();
+		IConv::utf8ToLocale_(data);
+		w << data;
+		itsService->colorizeOutput(w);
+	}
+	else
+		w << NC::clRed << result.second << NC::clEnd;
 	w.flush();
-	w.refresh();
+	if (isVisible(this))
+		w.refresh();
 	isDownloadInProgress = 0;
-	isReadyToTake = 0;
 }
 
 void Lastfm::switchTo()
@@ -87,9 +188,6 @@ void Lastfm::switchTo()
 	if (myScreen != this)
 	{
 		SwitchTo::execute(this);
-		// get an old info if it waits
-		if (isReadyToTake)
-			Take();
 		Load();
 		drawHeader();
 	}
@@ -110,11 +208,7 @@ void Lastfm::Load()
 	w.clear();
 	w.reset();
 	
-	std::string artist = itsArgs.find("artist")->second;
-	std::string file = lowercase(artist + ".txt");
-	removeInvalidCharsFromFilename(file);
-	
-	itsFilename = itsFolder + "/" + file;
+	itsFilename = artistFilename(itsArgs.find("artist")->second);
 	
 	mkdir(itsFolder.c_str()
 #	ifndef WIN32
@@ -122,8 +216,9 @@ void Lastfm::Load()
 #	endif // !WIN32
 	     );
 	
+	CacheState state = cacheState(itsFilename);
 	std::ifstream input(itsFilename.c_str());
-	if (input.is_open())
+	if (state != CacheState::Missing && input.is_open())
 	{
 		bool first = 1;
 		std::string line;
@@ -137,12 +232,15 @@ void Lastfm::Load()
 		}
 		input.close();
 		itsService->colorizeOutput(w);
+		touch(itsFilename);
+		// outdated info is shown until the new one is downloaded
+		if (state == CacheState::Stale)
+			Refresh();
 	}
 	else
 	{
 		w << L"Fetching informations... ";
-		pthread_create(&itsDownloader, 0, DownloadWrapper, this);
-		isDownloadInProgress = 1;
+		Download();
 	}
 	w.flush();
 }
@@ -153,44 +251,69 @@ void Lastfm::SetTitleAndFolder()
 	{
 		itsTitle = L"Artist info - ";
 		itsTitle += ToWString(itsArgs.find("artist")->second);
-		itsFolder = Config.ncmpcpp_directory + "artists";
+		itsFolder = artistsFolder();
 	}
 }
 
-void *Lastfm::DownloadWrapper(void *this_ptr)
+void Lastfm::Download()
 {
-	static_cast<Lastfm *>(this_ptr)->Download();
-	pthread_exit(0);
+	// service and its arguments can't be changed
+	// until the download is finished
+	isDownloadInProgress = 1;
+	// if the file is already being downloaded in the background,
+	// the info is fetched only to be displayed
+	bool save = Downloads.insert(itsFilename).second;
+	Workers::run([this, save]() {
+		LastfmService::Result result = save
+			? fetchAndSave(*itsService, itsArgs, itsFilename)
+			: itsService->fetch(itsArgs);
+		Workers::post([this, result, save]() {
+			if (save)
+				Downloads.erase(itsFilename);
+			Take(result);
+		});
+	}, true);
 }
 
-void Lastfm::Download()
+void Lastfm::Refresh()
 {
-	LastfmService::Result result = itsService->fetch(itsArgs);
-	
-	if (result.first)
-	{
-		Save(result.second);
-		w.clear();
-		IConv::utf8ToLocale_(result.second);
-		w << result.second;
-		itsService->colorizeOutput(w);
-	}
-	else
-		w << NC::clRed << result.second << NC::clEnd;
-	
-	isReadyToTake = 1;
+	if (!Downloads.insert(itsFilename).second)
+		return;
+	LastfmService::Args args = itsArgs;
+	std::string filename = itsFilename;
+	Workers::run([this, args, filename]() {
+		ArtistInfo service;
+		LastfmService::Result result = fetchAndSave(service, args, filename);
+		Workers::post([this, result, filename]() {
+			Downloads.erase(filename);
+			// replace displayed info if it wasn't changed meanwhile
+			if (result.first && filename == itsFilename && !isDownloadInProgress)
+				Take(result);
+		});
+	});
 }
 
-void Lastfm::Save(const std::string &data)
+void Lastfm::Prefetch(const std::string &artist)
 {
-	std::ofstream output(itsFilename.c_str());
-	if (output.is_open())
-	{
-		output << data;
-		output.close();
-	}
-	else
-		Error("couldn't save file \"" << itsFilename << "\"");
+	if (artist.empty())
+		return;
+	std::string filename = artistFilename(artist);
+	if (cacheState(filename) == CacheState::Fresh || !Downloads.insert(filename).second)
+		return;
+	mkdir(artistsFolder().c_str()
+#	ifndef WIN32
+	, 0755
+#	endif // !WIN32
+	     );
+	LastfmService::Args args;
+	args["artist"] = artist;
+	if (!Config.lastfm_preferred_language.empty())
+		args["lang"] = Config.lastfm_preferred_language;
+	Workers::run([args, filename]() {
+		ArtistInfo service;
+		fetchAndSave(service, args, filename);
+		Workers::post([filename]() { Downloads.erase(filename); });
+	});
 }
 
 void Lastfm::Refetch()
@@ -26,7 +26,6 @@
 #ifdef HAVE_CURL_CURL_H
 
 #include <memory>
-#include <pthread.h>
 
 #include "interfaces.h"
 #include "lastfm_service.h"
@@ -42,7 +41,7 @@ struct Lastfm: Screen<NC::Scrollpad>, Tabbable
 	virtual std::wstring title() OVERRIDE;
 	virtual ScreenType type() OVERRIDE { return ScreenType::Lastfm; }
 	
-	virtual void update() OVERRIDE;
+	virtual void update() OVERRIDE { }
 	
 	virtual void enterPressed() OVERRIDE { }
 	virtual void spacePressed() OVERRIDE { }
@@ -52,9 +51,13 @@ struct Lastfm: Screen<NC::Scrollpad>, Tabbable
 	// private members
 	void Refetch();
 	
-	bool isDownloading() { return isDownloadInProgress && !isReadyToTake; }
+	bool isDownloading() { return isDownloadInProgress; }
 	bool SetArtistInfoArgs(const std::string &artist, const std::string &lang = "");
 	
+	/// downloads info about the artist in background
+	/// unless up-to-date one is already cached
+	static void Prefetch(const std::string &artist);
+	
 protected:
 	virtual bool isLockable() OVERRIDE { return false; }
 	
@@ -70,16 +73,13 @@ private:
 	LastfmService::Args itsArgs;
 	
 	void Load();
-	void Save(const std::string &data);
 	void SetTitleAndFolder();
 	
 	void Download();
-	static void *DownloadWrapper(void *);
+	void Refresh();
 	
-	void Take();
-	bool isReadyToTake;
+	void Take(const LastfmService::Result &result);
 	bool isDownloadInProgress;
-	pthread_t itsDownloader;
 };
 
 extern Lastfm *myLastfm;
@@ -22,6 +22,7 @@
 #include <cerrno>
 #include <cstring>
 #include <fstream>
+#include <sstream>
 
 #include "browser.h"
 #include "charset.h"
@@ -29,6 +30,7 @@
 #include "global.h"
 #include "helpers.h"
 #include "lyrics.h"
+#include "lyrics_store.h"
 #include "playlist.h"
 #include "scrollpad.h"
 #include "settings.h"
@@ -36,24 +38,28 @@
 #include "statusbar.h"
 #include "title.h"
 #include "screen_switcher.h"
+#include "workers.h"
 
 using Global::MainHeight;
 using Global::MainStartY;
 
 #ifdef HAVE_CURL_CURL_H
 LyricsFetcher **Lyrics::itsFetcher = 0;
-std::queue<MPD::Song *> Lyrics::itsToDownload;
-pthread_mutex_t Lyrics::itsDIBLock = PTHREAD_MUTEX_INITIALIZER;
-size_t Lyrics::itsWorkersNumber = 0;
+size_t Lyrics::itsBackgroundDownloads = 0;
+bool Lyrics::isPrefetchInProgress = 0;
+time_t Lyrics::itsLastPrefetch = 0;
+std::unordered_set<std::string> Lyrics::itsPrefetched;
 #endif // HAVE_CURL_CURL_H
 
+std::unordered_set<std::string> Lyrics::itsEdited;
+
 Lyrics *myLyrics;
 
 Lyrics::Lyrics()
 : Screen(NC::Scrollpad(0, MainStartY, COLS, MainHeight, "", Config.main_color, NC::brNone))
 , ReloadNP(0),
 #ifdef HAVE_CURL_CURL_H
-isReadyToTake(0), isDownloadInProgress(0),
+isDownloadInProgress(0),
 #endif // HAVE_CURL_CURL_H
 	itsScrollBegin(0)
 { }
@@ -69,16 +75,6 @@ void Lyrics::resize()
 
 void Lyrics::update()
 {
-#	ifdef HAVE_CURL_CURL_H
-	if (isReadyToTake)
-		Take();
-	
-	if (isDownloadInProgress)
-	{
-		w.flush();
-		w.refresh();
-	}
-#	endif // HAVE_CURL_CURL_H
 	if (ReloadNP)
 	{
 		const MPD::Song s = myPlaylist->nowPlayingSong();
@@ -99,11 +95,7 @@ void Lyrics::switchTo()
 	if (myScreen != this)
 	{
 #		ifdef HAVE_CURL_CURL_H
-		// take lyrics if they were downloaded
-		if (isReadyToTake)
-			Take();
-		
-		if (isDownloadInProgress || itsWorkersNumber > 0)
+		if (isDownloadInProgress || itsBackgroundDownloads > 0)
 		{
 			Statusbar::msg("Lyrics are being downloaded...");
 			return;
@@ -149,119 +141,178 @@ void Lyrics::DownloadInBackground(const MPD::Song &s)
 		return;
 	
 	std::string filename = GenerateFilename(s);
-	std::ifstream f(filename.c_str());
-	if (f.is_open())
-	{
-		f.close();
+	if (Exist(filename))
 		return;
-	}
 	Statusbar::msg("Fetching lyrics for \"%s\"...", s.toString(Config.song_status_format_no_colors, Config.tags_separator).c_str());
 	
-	MPD::Song *s_copy = new MPD::Song(s);
-	pthread_mutex_lock(&itsDIBLock);
-	if (itsWorkersNumber == itsMaxWorkersNumber)
-		itsToDownload.push(s_copy);
+	++itsBackgroundDownloads;
+	std::string artist = Curl::escape(s.getArtist());
+	std::string title = Curl::escape(s.getTitle());
+	auto finish = [filename](const LyricsFetcher::Result &result) {
+		if (result.first == true)
+			Save(filename, result.second);
+		Workers::post([]() { --itsBackgroundDownloads; });
+	};
+	if (Config.fetch_lyrics_concurrently && !(itsFetcher && *itsFetcher))
+		raceLyricsPlugins(artist, title, finish);
 	else
 	{
-		++itsWorkersNumber;
-		pthread_t t;
-		pthread_attr_t attr;
-		pthread_attr_init(&attr);
-		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
-		pthread_create(&t, &attr, DownloadInBackgroundImpl, s_copy);
+		LyricsFetcher **fetcher = itsFetcher;
+		Workers::run([artist, title, fetcher, finish]() {
+			finish(DownloadInBackgroundImpl(artist, title, fetcher));
+		});
 	}
-	pthread_mutex_unlock(&itsDIBLock);
 }
 
-void *Lyrics::DownloadInBackgroundImpl(void *void_ptr)
+void Lyrics::Prefetch()
 {
-	MPD::Song *s = static_cast<MPD::Song *>(void_ptr);
-	DownloadInBackgroundImplHelper(*s);
-	delete s;
+	// fetch one song at a time and not more often than every few
+	// seconds so that databases are not flooded with requests
+	const time_t interval = 5;
 	
-	while (true)
+	if (Config.lyrics_prefetch_count == 0 || !Mpd.isPlaying() || Mpd.GetSingle())
+		return;
+	if (isPrefetchInProgress || itsBackgroundDownloads > 0 || myLyrics->isDownloadInProgress
+	||  Global::Timer.tv_sec < itsLastPrefetch+interval)
+		return;
+	
+	std::vector<int> positions;
+	if (Mpd.GetRandom())
 	{
-		pthread_mutex_lock(&itsDIBLock);
-		if (itsToDownload.empty())
-		{
-			pthread_mutex_unlock(&itsDIBLock);
-			break;
-		}
-		else
+		// in random mode only the next song is known
+		int next = Mpd.GetNextSongPos();
+		if (next >= 0)
+			positions.push_back(next);
+	}
+	else
+	{
+		int length = Mpd.GetPlaylistLength();
+		int pos = Mpd.GetCurrentSongPos();
+		for (unsigned i = 0; i < Config.lyrics_prefetch_count; ++i)
 		{
-			s = itsToDownload.front();
-			itsToDownload.pop();
-			pthread_mutex_unlock(&itsDIBLock);
+			if (++pos >= length)
+			{
+				if (!Mpd.GetRepeat())
+					break;
+				pos = 0;
+			}
+			positions.push_back(pos);
 		}
-		DownloadInBackgroundImplHelper(*s);
-		delete s;
 	}
 	
-	pthread_mutex_lock(&itsDIBLock);
-	--itsWorkersNumber;
-	pthread_mutex_unlock(&itsDIBLock);
+	if (itsPrefetched.size() > 1000)
+		itsPrefetched.clear();
 	
-	pthread_exit(0);
+	MPD::Song s;
+	std::string filename;
+	withUnfilteredMenu(myPlaylist->main(), [&]() {
+		for (auto pos = positions.begin(); pos != positions.end(); ++pos)
+		{
+			if (size_t(*pos) >= myPlaylist->main().size())
+				continue;
+			const MPD::Song &song = myPlaylist->main().at(*pos).value();
+			if (song.getArtist().empty() || song.getTitle().empty())
+				continue;
+			filename = GenerateFilename(song);
+			if (!itsPrefetched.insert(filename).second)
+				continue;
+			if (!Exist(filename))
+			{
+				s = song;
+				break;
+			}
+		}
+	});
+	if (s.empty())
+		return;
+	
+	isPrefetchInProgress = 1;
+	itsLastPrefetch = Global::Timer.tv_sec;
+	std::string artist = Curl::escape(s.getArtist());
+	std::string title = Curl::escape(s.getTitle());
+	LyricsFetcher **fetcher = itsFetcher;
+	Workers::run([artist, title, fetcher, filename]() {
+		LyricsFetcher::Result result = DownloadInBackgroundImpl(artist, title, fetcher);
+		if (result.first == true)
+			Save(filename, result.second);
+		Workers::post([]() { isPrefetchInProgress = 0; });
+	});
 }
 
-void Lyrics::DownloadInBackgroundImplHelper(const MPD::Song &s)
+LyricsFetcher::Result Lyrics::DownloadInBackgroundImpl(const std::string &artist, const std::string &title, LyricsFetcher **fetcher)
 {
-	std::string artist = Curl::escape(s.getArtist());
-	std::string title = Curl::escape(s.getTitle());
-	
 	LyricsFetcher::Result result;
-	bool fetcher_defined = itsFetcher && *itsFetcher;
-	for (LyricsFetcher **plugin = fetcher_defined ? itsFetcher : lyricsPlugins; *plugin != 0; ++plugin)
+	bool fetcher_defined = fetcher && *fetcher;
+	std::vector<LyricsFetcher *> plugins = fetcher_defined
+		? std::vector<LyricsFetcher *>(1, *fetcher)
+		: lyricsPluginsByPriority();
+	for (auto plugin = plugins.begin(); plugin != plugins.end(); ++plugin)
 	{
-		result = (*plugin)->fetch(artist, title);
+		result = fetchLyrics(*plugin, artist, title);
 		if (result.first)
 			break;
-		if (fetcher_defined)
-			break;
 	}
-	if (result.first == true)
-		Save(GenerateFilename(s), result.second);
+	return result;
 }
 
-void *Lyrics::Download()
+void Lyrics::Download()
 {
 	std::string artist = Curl::escape(itsSong.getArtist());
 	std::string title_ = Curl::escape(itsSong.getTitle());
+	std::string filename = itsFilename;
+	LyricsFetcher **fetcher = itsFetcher;
+	bool fetcher_defined = fetcher && *fetcher;
 	
-	LyricsFetcher::Result result;
-	
-	// if one of plugins is selected, try only this one,
-	// otherwise try all of them until one of them succeeds
-	bool fetcher_defined = itsFetcher && *itsFetcher;
-	for (LyricsFetcher **plugin = fetcher_defined ? itsFetcher : lyricsPlugins; *plugin != 0; ++plugin)
+	isDownloadInProgress = 1;
+	if (Config.fetch_lyrics_concurrently && !fetcher_defined)
 	{
-		w << L"Fetching lyrics from " << NC::fmtBold << ToWString((*plugin)->name()) << NC::fmtBoldEnd << L"... ";
-		result = (*plugin)->fetch(artist, title_);
-		if (result.first == false)
-			w << NC::clRed << ToWString(result.second) << NC::clEnd << '\n';
-		else
-			break;
-		if (fetcher_defined)
-			break;
-	}
-	
-	if (result.first == true)
-	{
-		Save(itsFilename, result.second);
-		w.clear();
-		IConv::utf8ToLocale_(result.second);
-		w << result.second;
+		w << L"Fetching lyrics from all databases... ";
+		w.flush();
+		raceLyricsPlugins(artist, title_, [this, filename](const LyricsFetcher::Result &result) {
+			if (result.first == true)
+				Save(filename, result.second);
+			Workers::post([this, result]() {
+				if (result.first == false)
+					w << NC::clRed << ToWString(result.second) << NC::clEnd << '\n';
+				Take(result);
+			});
+		});
+		return;
 	}
-	else
-		w << '\n' << L"Lyrics weren't found.";
 	
-	isReadyToTake = 1;
-	pthread_exit(0);
-}
-
-void *Lyrics::DownloadWrapper(void *this_ptr)
-{
-	return static_cast<Lyrics *>(this_ptr)->Download();
+	Workers::run([this, artist, title_, filename, fetcher, fetcher_defined]() {
+		LyricsFetcher::Result result;
+		
+		// if one of plugins is selected, try only this one,
+		// otherwise try all of them until one of them succeeds
+		std::vector<LyricsFetcher *> plugins = fetcher_defined
+			? std::vector<LyricsFetcher *>(1, *fetcher)
+			: lyricsPluginsByPriority();
+		for (auto plugin = plugins.begin(); plugin != plugins.end(); ++plugin)
+		{
+			const char *name = (*plugin)->name();
+			Workers::post([this, name]() {
+				w << L"Fetching lyrics from " << NC::fmtBold << ToWString(name) << NC::fmtBoldEnd << L"... ";
+				w.flush();
+				if (isVisible(this))
+					w.refresh();
+			});
+			result = fetchLyrics(*plugin, artist, title_);
+			if (result.first == false)
+			{
+				std::string error = result.second;
+				Workers::post([this, error]() {
+					w << NC::clRed << ToWString(error) << NC::clEnd << '\n';
+				});
+			}
+			else
+				break;
+		}
+		
+		if (result.first == true)
+			Save(filename, result.second);
+		Workers::post([this, result]() { Take(result); });
+	}, true);
 }
 #endif // HAVE_CURL_CURL_H
 
@@ -315,11 +366,12 @@ void Lyrics::Load()
 	w.clear();
 	w.reset();
 	
-	std::ifstream input(itsFilename.c_str());
-	if (input.is_open())
+	std::string lyrics;
+	if (Read(itsFilename, lyrics))
 	{
 		bool first = 1;
 		std::string line;
+		std::istringstream input(lyrics);
 		while (getline(input, line))
 		{
 			if (!first)
@@ -335,8 +387,7 @@ void Lyrics::Load()
 	else
 	{
 #		ifdef HAVE_CURL_CURL_H
-		pthread_create(&itsDownloader, 0, DownloadWrapper, this);
-		isDownloadInProgress = 1;
+		Download();
 #		else
 		w << U("Local lyrics not found. As ncmpcpp has been compiled without curl support, you can put appropriate lyrics into ") << TO_WSTRING(Config.lyrics_directory) << U(" directory (file syntax is \"$ARTIST - $TITLE.txt\") or recompile ncmpcpp with curl support.");
 		w.flush();
@@ -344,6 +395,27 @@ void Lyrics::Load()
 	}
 }
 
+bool Lyrics::Read(const std::string &filename, std::string &lyrics)
+{
+	if (Config.lyrics_store && itsEdited.find(filename) == itsEdited.end()
+	&&  LyricsStore::get(filename, lyrics))
+		return true;
+	// if lyrics are not in the store yet or were edited,
+	// they're read from the file and imported into it
+	std::ifstream input(filename.c_str(), std::ios::binary);
+	if (input.is_open())
+	{
+		lyrics.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+		// edited file is read each time lyrics are loaded,
+		// but it's imported only if it actually changed
+		std::string stored;
+		if (Config.lyrics_store && (!LyricsStore::get(filename, stored) || stored != lyrics))
+			LyricsStore::put(filename, lyrics);
+		return true;
+	}
+	return Config.lyrics_store && LyricsStore::get(filename, lyrics);
+}
+
 void Lyrics::Edit()
 {
 	assert(Global::myScreen == this);
@@ -354,6 +426,18 @@ void Lyrics::Edit()
 		return;
 	}
 	
+	if (Config.lyrics_store && itsEdited.find(itsFilename) == itsEdited.end())
+	{
+		// external editor needs a file to work with
+		std::string lyrics;
+		if (LyricsStore::get(itsFilename, lyrics))
+		{
+			std::ofstream output(itsFilename.c_str(), std::ios::binary);
+			output << lyrics;
+		}
+		itsEdited.insert(itsFilename);
+	}
+	
 	Statusbar::msg("Opening lyrics in external editor...");
 	
 	GNUC_UNUSED int res;
@@ -373,6 +457,11 @@ void Lyrics::Edit()
 #ifdef HAVE_CURL_CURL_H
 void Lyrics::Save(const std::string &filename, const std::string &lyrics)
 {
+	if (Config.lyrics_store)
+	{
+		LyricsStore::put(filename, lyrics);
+		return;
+	}
 	std::ofstream output(filename.c_str());
 	if (output.is_open())
 	{
@@ -381,8 +470,21 @@ void Lyrics::Save(const std::string &filename, const std::string &lyrics)
 	}
 }
 
+bool Lyrics::Exist(const std::string &filename)
+{
+	if (Config.lyrics_store)
+		return LyricsStore::contains(filename);
+	std::ifstream f(filename.c_str());
+	return f.is_open();
+}
+
 void Lyrics::Refetch()
 {
+	if (Config.lyrics_store)
+	{
+		LyricsStore::remove(itsFilename);
+		itsEdited.erase(itsFilename);
+	}
 	if (remove(itsFilename.c_str()) && errno != ENOENT)
 	{
 		const char msg[] = "Couldn't remove \"%ls\": %s";
@@ -404,14 +506,21 @@ void Lyrics::ToggleFetcher()
 		Statusbar::msg("Using all lyrics databases");
 }
 
-void Lyrics::Take()
+void Lyrics::Take(const LyricsFetcher::Result &result)
 {
-	assert(isReadyToTake);
-	pthread_join(itsDownloader, 0);
+	if (result.first == true)
+	{
+		std::string lyrics = result.second;
+		w.clear();
+		IConv::utf8ToLocale_(lyrics);
+		w << lyrics;
+	}
+	else
+		w << '\n' << L"Lyrics weren't found.";
 	w.flush();
-	w.refresh();
+	if (isVisible(this))
+		w.refresh();
 	isDownloadInProgress = 0;
-	isReadyToTake = 0;
 }
 #endif // HAVE_CURL_CURL_H
 
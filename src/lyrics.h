@@ -21,8 +21,7 @@
 #ifndef _LYRICS_H
 #define _LYRICS_H
 
-#include <pthread.h>
-#include <queue>
+#include <unordered_set>
 
 #include "interfaces.h"
 #include "lyrics_fetcher.h"
@@ -55,6 +54,10 @@ struct Lyrics: Screen<NC::Scrollpad>, Tabbable
 	
 	static void ToggleFetcher();
 	static void DownloadInBackground(const MPD::Song &s);
+	
+	/// fetches lyrics of songs that will be played next if there
+	/// are no other downloads in progress. called from main loop.
+	static void Prefetch();
 #	endif // HAVE_CURL_CURL_H
 	
 	bool ReloadNP;
@@ -64,28 +67,27 @@ protected:
 	
 private:
 	void Load();
+	static bool Read(const std::string &filename, std::string &lyrics);
+	// lyrics exported from the store to be edited in external editor
+	static std::unordered_set<std::string> itsEdited;
 	
 #	ifdef HAVE_CURL_CURL_H
-	static void *DownloadInBackgroundImpl(void *song_ptr);
-	static void DownloadInBackgroundImplHelper(const MPD::Song &s);
-	// lock for allowing exclusive access to itsToDownload and itsWorkersNumber
-	static pthread_mutex_t itsDIBLock;
-	// storage for songs for which lyrics are scheduled to be downloaded
-	static std::queue<MPD::Song *> itsToDownload;
-	// current worker threads (ie. downloading lyrics)
-	static size_t itsWorkersNumber;
-	// maximum number of worker threads. if it's reached, next lyrics requests
-	// are put into itsToDownload queue.
-	static const size_t itsMaxWorkersNumber = 4;
-	
-	void *Download();
-	static void *DownloadWrapper(void *);
+	static LyricsFetcher::Result DownloadInBackgroundImpl(const std::string &artist, const std::string &title,
+	                                                      LyricsFetcher **fetcher);
+	// number of lyrics that are being downloaded in background
+	static size_t itsBackgroundDownloads;
+	
+	static bool isPrefetchInProgress;
+	static time_t itsLastPrefetch;
+	// songs that were already checked by prefetcher
+	static std::unordered_set<std::string> itsPrefetched;
+	
+	void Download();
 	static void Save(const std::string &filename, const std::string &lyrics);
+	static bool Exist(const std::string &filename);
 	
-	void Take();
-	bool isReadyToTake;
+	void Take(const LyricsFetcher::Result &result);
 	bool isDownloadInProgress;
-	pthread_t itsDownloader;
 	
 	static LyricsFetcher **itsFetcher;
 #	endif // HAVE_CURL_CURL_H
@@ -22,13 +22,20 @@
 
 #ifdef HAVE_CURL_CURL_H
 
+#include <algorithm>
+#include <cassert>
 #include <cstdlib>
 #include <cstring>
+#include <map>
+#include <memory>
+#include <pthread.h>
+#include <sys/time.h>
 
 #include "charset.h"
 #include "lyrics_fetcher.h"
 #include "utility/html.h"
 #include "utility/string.h"
+#include "workers.h"
 
 LyricsFetcher *lyricsPlugins[] =
 {
@@ -51,15 +58,20 @@ const char LyricsFetcher::msgNotFound[] = "Not found";
 
 LyricsFetcher::Result LyricsFetcher::fetch(const std::string &artist, const std::string &title)
 {
-	Result result;
-	result.first = false;
-	
 	std::string url = getURL();
 	replace(url, "%artist%", artist.c_str());
 	replace(url, "%title%", title.c_str());
+	return fetchURL(url);
+}
+
+LyricsFetcher::Result LyricsFetcher::fetchURL(const std::string &url)
+{
+	Result result;
+	result.first = false;
 	
 	std::string data;
-	CURLcode code = Curl::perform(data, url);
+	bool parse_ok;
+	CURLcode code = fetchContent(url, getOpenTag(), getCloseTag(), data, parse_ok);
 	
 	if (code != CURLE_OK)
 	{
@@ -67,8 +79,6 @@ LyricsFetcher::Result LyricsFetcher::fetch(const std::string &artist, const std:
 		return result;
 	}
 	
-	bool parse_ok = getContent(getOpenTag(), getCloseTag(), data);
-	
 	if (!parse_ok || notLyrics(data))
 	{
 		result.second = msgNotFound;
@@ -82,20 +92,16 @@ LyricsFetcher::Result LyricsFetcher::fetch(const std::string &artist, const std:
 	return result;
 }
 
-bool LyricsFetcher::getContent(const char *open_tag, const char *close_tag, std::string &data)
+CURLcode LyricsFetcher::fetchContent(const std::string &url, const char *open_tag, const char *close_tag,
+                                     std::string &data, bool &found, const std::string &referer)
 {
-	size_t a, b;
-	if ((a = data.find(open_tag)) != std::string::npos)
-	{
-		a += strlen(open_tag);
-		if ((b = data.find(close_tag, a)) != std::string::npos)
-			data = data.substr(a, b-a);
-		else
-			return false;
-	}
-	else
-		return false;
-	return true;
+	HtmlExtractor extractor(open_tag, close_tag);
+	CURLcode code = Curl::perform([&extractor](const char *chunk, size_t length) {
+		return extractor.feed(chunk, length);
+	}, url, referer);
+	found = extractor.found();
+	data.swap(extractor.content());
+	return code;
 }
 
 void LyricsFetcher::postProcess(std::string &data)
@@ -114,7 +120,8 @@ LyricsFetcher::Result LyricwikiFetcher::fetch(const std::string &artist, const s
 		result.first = false;
 		
 		std::string data;
-		CURLcode code = Curl::perform(data, result.second);
+		bool parse_ok;
+		CURLcode code = fetchContent(result.second, "'17'/></a></div>", "<!--", data, parse_ok);
 		
 		if (code != CURLE_OK)
 		{
@@ -122,8 +129,6 @@ LyricsFetcher::Result LyricwikiFetcher::fetch(const std::string &artist, const s
 			return result;
 		}
 		
-		bool parse_ok = getContent("'17'/></a></div>", "<!--", data);
-		
 		if (!parse_ok)
 		{
 			result.second = msgNotFound;
@@ -154,6 +159,16 @@ bool LyricwikiFetcher::notLyrics(const std::string &data)
 /**********************************************************************/
 
 LyricsFetcher::Result GoogleLyricsFetcher::fetch(const std::string &artist, const std::string &title)
+{
+	// fetchers are used by several threads at once,
+	// so url can't be stored in the object
+	Result result = search(artist, title);
+	if (result.first)
+		result = fetchURL(result.second);
+	return result;
+}
+
+LyricsFetcher::Result GoogleLyricsFetcher::search(const std::string &artist, const std::string &title)
 {
 	Result result;
 	result.first = false;
@@ -169,7 +184,8 @@ LyricsFetcher::Result GoogleLyricsFetcher::fetch(const std::string &artist, cons
 	google_url += "&btnI=I%27m+Feeling+Lucky";
 	
 	std::string data;
-	CURLcode code = Curl::perform(data, google_url, google_url);
+	bool found_url;
+	CURLcode code = fetchContent(google_url, "<A HREF=\"", "\">here</A>", data, found_url, google_url);
 	
 	if (code != CURLE_OK)
 	{
@@ -177,7 +193,6 @@ LyricsFetcher::Result GoogleLyricsFetcher::fetch(const std::string &artist, cons
 		return result;
 	}
 	
-	bool found_url = getContent("<A HREF=\"", "\">here</A>", data);
 	
 	if (!found_url || !isURLOk(data))
 	{
@@ -185,12 +200,9 @@ LyricsFetcher::Result GoogleLyricsFetcher::fetch(const std::string &artist, cons
 		return result;
 	}
 	
-	data = unescapeHtmlUtf8(data);
-	//result.second = data;
-	//return result;
-	
-	URL = data.c_str();
-	return LyricsFetcher::fetch("", "");
+	result.second = unescapeHtmlUtf8(data);
+	result.first = true;
+	return result;
 }
 
 bool GoogleLyricsFetcher::isURLOk(const std::string &url)
@@ -280,18 +292,150 @@ void LyricsvipFetcher::postProcess(std::string &data)
 
 LyricsFetcher::Result InternetLyricsFetcher::fetch(const std::string &artist, const std::string &title)
 {
-	GoogleLyricsFetcher::fetch(artist, title);
+	LyricsFetcher::Result result = search(artist, title);
+	if (result.first)
+	{
+		result.first = false;
+		result.second = "The following site may contain lyrics for this song: " + result.second;
+	}
+	return result;
+}
+
+/**********************************************************************/
+
+namespace {//
+
+struct PluginStats
+{
+	PluginStats() : Attempts(0), Hits(0), Time(0) { }
+	
+	// plugin is demoted if it usually doesn't find anything
+	// or it takes too long for it to respond
+	bool isDemoted() const
+	{
+		return Attempts >= 5 && (Hits*10 < Attempts || Time/Attempts > 5.0);
+	}
+	
+	unsigned Attempts;
+	unsigned Hits;
+	// total time of all attempts in seconds
+	double Time;
+};
+
+pthread_mutex_t StatsLock = PTHREAD_MUTEX_INITIALIZER;
+std::map<LyricsFetcher *, PluginStats> Stats;
+
+double now()
+{
+	timeval t;
+	gettimeofday(&t, 0);
+	return t.tv_sec + t.tv_usec/1000000.0;
+}
+
+void recordAttempt(LyricsFetcher *plugin, bool hit, double time)
+{
+	pthread_mutex_lock(&StatsLock);
+	PluginStats &stats = Stats[plugin];
+	++stats.Attempts;
+	stats.Hits += hit;
+	stats.Time += time;
+	pthread_mutex_unlock(&StatsLock);
+}
+
+struct Race
+{
+	Race(const std::vector<LyricsFetcher *> &plugins)
+	: Plugins(plugins), Results(plugins.size()), Finished(plugins.size(), false), Decided(false), Aborted(false)
+	{
+		pthread_mutex_init(&Lock, 0);
+	}
+	~Race()
+	{
+		pthread_mutex_destroy(&Lock);
+	}
+	
+	void run(size_t i, const std::string &artist, const std::string &title);
+	
+	std::vector<LyricsFetcher *> Plugins;
+	std::function<void(const LyricsFetcher::Result &)> Callback;
+	
+	pthread_mutex_t Lock;
+	std::vector<LyricsFetcher::Result> Results;
+	std::vector<bool> Finished;
+	bool Decided;
+	std::atomic<bool> Aborted;
+};
+
+void Race::run(size_t i, const std::string &artist, const std::string &title)
+{
 	LyricsFetcher::Result result;
-	result.first = false;
-	result.second = "The following site may contain lyrics for this song: ";
-	result.second += URL;
+	if (Aborted)
+		result.first = false;
+	else
+	{
+		Curl::setAbortFlag(&Aborted);
+		double start = now();
+		result = Plugins[i]->fetch(artist, title);
+		double time = now()-start;
+		Curl::setAbortFlag(0);
+		// aborted attempts say nothing about the plugin
+		if (!Aborted)
+			recordAttempt(Plugins[i], result.first, time);
+	}
+	
+	pthread_mutex_lock(&Lock);
+	Results[i] = result;
+	Finished[i] = true;
+	if (!Decided)
+	{
+		// find the first plugin that didn't fail. if it's still
+		// running, we need to wait for it, otherwise it wins.
+		size_t first = 0;
+		while (first < Plugins.size() && Finished[first] && !Results[first].first)
+			++first;
+		if (first == Plugins.size() || Finished[first])
+		{
+			Decided = true;
+			Aborted = true;
+			pthread_mutex_unlock(&Lock);
+			Callback(Results[first == Plugins.size() ? first-1 : first]);
+			return;
+		}
+	}
+	pthread_mutex_unlock(&Lock);
+}
+
+}
+
+std::vector<LyricsFetcher *> lyricsPluginsByPriority()
+{
+	std::vector<LyricsFetcher *> result;
+	for (LyricsFetcher **plugin = lyricsPlugins; *plugin != 0; ++plugin)
+		result.push_back(*plugin);
+	pthread_mutex_lock(&StatsLock);
+	std::stable_partition(result.begin(), result.end(), [](LyricsFetcher *p) {
+		return !Stats[p].isDemoted();
+	});
+	pthread_mutex_unlock(&StatsLock);
+	return result;
+}
+
+LyricsFetcher::Result fetchLyrics(LyricsFetcher *plugin, const std::string &artist, const std::string &title)
+{
+	double start = now();
+	LyricsFetcher::Result result = plugin->fetch(artist, title);
+	recordAttempt(plugin, result.first, now()-start);
 	return result;
 }
 
-bool InternetLyricsFetcher::isURLOk(const std::string &url)
+void raceLyricsPlugins(const std::string &artist, const std::string &title,
+                       std::function<void(const LyricsFetcher::Result &)> callback)
 {
-	URL = url;
-	return false;
+	auto race = std::make_shared<Race>(lyricsPluginsByPriority());
+	assert(!race->Plugins.empty());
+	race->Callback = callback;
+	for (size_t i = 0; i < race->Plugins.size(); ++i)
+		Workers::run([race, i, artist, title]() { race->run(i, artist, title); });
 }
 
 #endif // HAVE_CURL_CURL_H
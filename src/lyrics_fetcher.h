@@ -25,7 +25,11 @@
 
 #ifdef HAVE_CURL_CURL_H
 
+#include <functional>
 #include <string>
+#include <vector>
+
+#include "curl_handle.h"
 
 struct LyricsFetcher
 {
@@ -42,7 +46,13 @@ protected:
 	virtual bool notLyrics(const std::string &) { return false; }
 	virtual void postProcess(std::string &data);
 	
-	bool getContent(const char *open_tag, const char *close_tag, std::string &data);
+	Result fetchURL(const std::string &url);
+	
+	/// downloads the page, keeping only its part between given tags. transfer
+	/// is stopped as soon as closing tag is received.
+	/// @param found set to true if the tags were found
+	CURLcode fetchContent(const std::string &url, const char *open_tag, const char *close_tag,
+	                      std::string &data, bool &found, const std::string &referer = "");
 	
 	static const char msgNotFound[];
 };
@@ -78,12 +88,13 @@ struct GoogleLyricsFetcher : public LyricsFetcher
 	
 protected:
 	virtual const char *getSiteKeyword() = 0;
-	virtual const char *getURL() { return URL; }
+	// url of the page with lyrics is found by google
+	virtual const char *getURL() { return ""; }
 	
 	virtual bool isURLOk(const std::string &url);
 	
-private:
-	const char *URL;
+	/// @return url of the page with lyrics on success
+	Result search(const std::string &artist, const std::string &title);
 };
 
 struct LyricstimeFetcher : public GoogleLyricsFetcher
@@ -200,14 +211,27 @@ protected:
 	virtual const char *getOpenTag() { return ""; }
 	virtual const char *getCloseTag() { return ""; }
 	
-	virtual bool isURLOk(const std::string &url);
-	
-private:
-	std::string URL;
+	virtual bool isURLOk(const std::string &) { return true; }
 };
 
 extern LyricsFetcher *lyricsPlugins[];
 
+/// @return plugins in order they should be tried. plugins that turned out
+/// to be slow or rarely successful are moved to the end of the list.
+std::vector<LyricsFetcher *> lyricsPluginsByPriority();
+
+/// fetches lyrics using given plugin and records how long
+/// it took and whether it was successful
+LyricsFetcher::Result fetchLyrics(LyricsFetcher *plugin, const std::string &artist, const std::string &title);
+
+/// queries all plugins at once (using worker threads). as soon as the plugin
+/// with the highest priority among those that didn't fail finds lyrics, the
+/// remaining queries are aborted and the callback is called with its result.
+/// if all of them fail, result of the last one is passed. the callback is
+/// called once, from one of the worker threads.
+void raceLyricsPlugins(const std::string &artist, const std::string &title,
+                       std::function<void(const LyricsFetcher::Result &)> callback);
+
 #endif // HAVE_CURL_CURL_H
 
 #endif
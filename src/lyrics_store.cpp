@@ -0,0 +1,594 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2012 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#include <cstdio>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "config.h"
+#include "gcc.h"
+#include "lyrics_store.h"
+
+#ifdef HAVE_ZLIB_H
+# include <zlib.h>
+#endif // HAVE_ZLIB_H
+
+namespace {//
+
+const uint32_t RecordMagic = 0x52594c4e; // NLYR
+const uint32_t IndexMagic = 0x58494c4e; // NLIX
+
+enum RecordFlags { rfCompressed = 1, rfRemoved = 2 };
+
+// data file consists of records, each of them is a header
+// followed by the key and (possibly compressed) lyrics.
+struct RecordHeader
+{
+	uint32_t Magic;
+	uint32_t KeyLength;
+	uint32_t StoredLength;
+	uint32_t Length;
+	uint32_t Flags;
+};
+
+struct Entry
+{
+	uint64_t Offset;
+	uint32_t StoredLength;
+	uint32_t Length;
+	uint32_t Flags;
+};
+
+// index file is a header followed by entries, each of them
+// followed by the key. it's valid for the first DataSize
+// bytes of data file, the rest is scanned when it's loaded.
+struct IndexHeader
+{
+	uint32_t Magic;
+	uint32_t Count;
+	uint64_t DataSize;
+	uint64_t DeadSize;
+};
+
+struct IndexEntry
+{
+	uint64_t Offset;
+	uint32_t StoredLength;
+	uint32_t Length;
+	uint32_t Flags;
+	uint32_t KeyLength;
+};
+
+pthread_mutex_t Lock = PTHREAD_MUTEX_INITIALIZER;
+
+// the store may be shared by a few instances of ncmpcpp. each of them
+// holds shared lock on the lock file while the store is open, so that
+// data file is compacted only if there are no other ones. data file
+// is locked exclusively while records are appended to it.
+int LockFD = -1;
+int DataFD = -1;
+std::string Directory;
+std::unordered_map<std::string, Entry> Index;
+uint64_t DataSize = 0;
+// size of records that were replaced or removed
+uint64_t DeadSize = 0;
+
+std::string dataPath()
+{
+	return Directory + "/lyrics.db";
+}
+
+std::string indexPath()
+{
+	return Directory + "/lyrics.idx";
+}
+
+std::string lockPath()
+{
+	return Directory + "/lyrics.lock";
+}
+
+uint64_t recordSize(size_t key_length, uint32_t stored_length)
+{
+	return sizeof(RecordHeader) + key_length + stored_length;
+}
+
+bool readAt(int fd, void *buffer, size_t length, uint64_t offset)
+{
+	char *p = static_cast<char *>(buffer);
+	while (length > 0)
+	{
+		ssize_t n = pread(fd, p, length, offset);
+		if (n <= 0)
+			return false;
+		p += n;
+		offset += n;
+		length -= n;
+	}
+	return true;
+}
+
+bool writeAll(int fd, const void *buffer, size_t length)
+{
+	const char *p = static_cast<const char *>(buffer);
+	while (length > 0)
+	{
+		ssize_t n = write(fd, p, length);
+		if (n <= 0)
+			return false;
+		p += n;
+		length -= n;
+	}
+	return true;
+}
+
+void addToIndex(const std::string &key, const Entry &e)
+{
+	auto it = Index.find(key);
+	if (it != Index.end())
+		DeadSize += recordSize(key.length(), it->second.StoredLength);
+	if (e.Flags & rfRemoved)
+	{
+		DeadSize += recordSize(key.length(), e.StoredLength);
+		if (it != Index.end())
+			Index.erase(it);
+	}
+	else if (it != Index.end())
+		it->second = e;
+	else
+		Index[key] = e;
+}
+
+void encode(const std::string &lyrics, std::string &stored, uint32_t &flags)
+{
+	flags = 0;
+#	ifdef HAVE_ZLIB_H
+	uLongf length = compressBound(lyrics.length());
+	stored.resize(length);
+	if (compress2(reinterpret_cast<Bytef *>(&stored[0]), &length,
+	              reinterpret_cast<const Bytef *>(lyrics.data()), lyrics.length(), 6) == Z_OK
+	&&  length < lyrics.length())
+	{
+		stored.resize(length);
+		flags |= rfCompressed;
+		return;
+	}
+#	endif // HAVE_ZLIB_H
+	stored = lyrics;
+}
+
+bool decode(const std::string &stored, const Entry &e, std::string &lyrics)
+{
+	if (!(e.Flags & rfCompressed))
+	{
+		lyrics = stored;
+		return true;
+	}
+#	ifdef HAVE_ZLIB_H
+	uLongf length = e.Length;
+	lyrics.resize(length);
+	if (uncompress(reinterpret_cast<Bytef *>(&lyrics[0]), &length,
+	               reinterpret_cast<const Bytef *>(stored.data()), stored.length()) == Z_OK
+	&&  length == e.Length)
+		return true;
+#	endif // HAVE_ZLIB_H
+	lyrics.clear();
+	return false;
+}
+
+uint64_t loadIndex(uint64_t data_size)
+{
+	FILE *f = fopen(indexPath().c_str(), "rb");
+	if (!f)
+		return 0;
+	IndexHeader header;
+	if (fread(&header, sizeof(header), 1, f) != 1
+	||  header.Magic != IndexMagic
+	||  header.DataSize > data_size)
+	{
+		fclose(f);
+		return 0;
+	}
+	Index.reserve(header.Count);
+	std::string key;
+	for (uint32_t i = 0; i < header.Count; ++i)
+	{
+		IndexEntry ie;
+		if (fread(&ie, sizeof(ie), 1, f) != 1)
+			break;
+		key.resize(ie.KeyLength);
+		if (ie.KeyLength > 0 && fread(&key[0], ie.KeyLength, 1, f) != 1)
+			break;
+		Entry &e = Index[key];
+		e.Offset = ie.Offset;
+		e.StoredLength = ie.StoredLength;
+		e.Length = ie.Length;
+		e.Flags = ie.Flags;
+	}
+	fclose(f);
+	if (Index.size() != header.Count)
+	{
+		Index.clear();
+		return 0;
+	}
+	DeadSize = header.DeadSize;
+	return header.DataSize;
+}
+
+bool saveIndex()
+{
+	std::string tmp = indexPath() + ".tmp";
+	FILE *f = fopen(tmp.c_str(), "wb");
+	if (!f)
+		return false;
+	IndexHeader header;
+	header.Magic = IndexMagic;
+	header.Count = Index.size();
+	header.DataSize = DataSize;
+	header.DeadSize = DeadSize;
+	bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+	for (auto it = Index.begin(); ok && it != Index.end(); ++it)
+	{
+		IndexEntry ie;
+		ie.Offset = it->second.Offset;
+		ie.StoredLength = it->second.StoredLength;
+		ie.Length = it->second.Length;
+		ie.Flags = it->second.Flags;
+		ie.KeyLength = it->first.length();
+		ok = fwrite(&ie, sizeof(ie), 1, f) == 1
+		&&   fwrite(it->first.data(), 1, it->first.length(), f) == it->first.length();
+	}
+	ok = fclose(f) == 0 && ok;
+	if (ok)
+		ok = rename(tmp.c_str(), indexPath().c_str()) == 0;
+	else
+		unlink(tmp.c_str());
+	return ok;
+}
+
+// reads records that are not covered by index
+void scan(uint64_t offset, uint64_t data_size)
+{
+	std::string key;
+	while (offset < data_size)
+	{
+		RecordHeader header;
+		if (!readAt(DataFD, &header, sizeof(header), offset)
+		||  header.Magic != RecordMagic
+		||  offset+recordSize(header.KeyLength, header.StoredLength) > data_size)
+			break;
+		key.resize(header.KeyLength);
+		if (!readAt(DataFD, &key[0], header.KeyLength, offset+sizeof(header)))
+			break;
+		Entry e;
+		e.Offset = offset;
+		e.StoredLength = header.StoredLength;
+		e.Length = header.Length;
+		e.Flags = header.Flags;
+		addToIndex(key, e);
+		offset += recordSize(header.KeyLength, header.StoredLength);
+	}
+	// drop incomplete record left by interrupted write
+	if (offset < data_size)
+	{
+		GNUC_UNUSED int res;
+		res = ftruncate(DataFD, offset);
+	}
+	DataSize = offset;
+}
+
+// picks up records appended by other instances. data file has
+// to be locked exclusively, so that no record is being written.
+void catchUp()
+{
+	struct stat st;
+	if (fstat(DataFD, &st) == 0 && uint64_t(st.st_size) != DataSize)
+		scan(DataSize, st.st_size);
+}
+
+bool append(const std::string &key, const std::string &stored, uint32_t length, uint32_t flags)
+{
+	RecordHeader header;
+	header.Magic = RecordMagic;
+	header.KeyLength = key.length();
+	header.StoredLength = stored.length();
+	header.Length = length;
+	header.Flags = flags;
+	std::string record;
+	record.reserve(recordSize(key.length(), stored.length()));
+	record.append(reinterpret_cast<const char *>(&header), sizeof(header));
+	record += key;
+	record += stored;
+	// offset is taken from the file itself since
+	// other instances might have appended to it
+	flock(DataFD, LOCK_EX);
+	catchUp();
+	off_t offset = lseek(DataFD, 0, SEEK_END);
+	bool ok = offset >= 0 && writeAll(DataFD, record.data(), record.length());
+	if (ok)
+	{
+		Entry e;
+		e.Offset = offset;
+		e.StoredLength = header.StoredLength;
+		e.Length = header.Length;
+		e.Flags = header.Flags;
+		DataSize = offset+record.length();
+		addToIndex(key, e);
+	}
+	else if (offset >= 0)
+	{
+		GNUC_UNUSED int res;
+		res = ftruncate(DataFD, offset);
+	}
+	flock(DataFD, LOCK_UN);
+	return ok;
+}
+
+bool readStored(const std::string &key, const Entry &e, std::string &stored)
+{
+	stored.resize(e.StoredLength);
+	return e.StoredLength == 0
+	||     readAt(DataFD, &stored[0], e.StoredLength, e.Offset+sizeof(RecordHeader)+key.length());
+}
+
+void openDataFile()
+{
+	DataFD = ::open(dataPath().c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	if (DataFD < 0)
+		return;
+	// scan drops incomplete records, so no one can be writing one
+	flock(DataFD, LOCK_EX);
+	struct stat st;
+	if (fstat(DataFD, &st) == 0)
+		scan(loadIndex(st.st_size), st.st_size);
+	flock(DataFD, LOCK_UN);
+}
+
+bool replaceDataFile();
+
+bool compactUnlocked()
+{
+	// other instances would keep appending to the old file,
+	// so it can be replaced only if there are none of them.
+	if (flock(LockFD, LOCK_EX | LOCK_NB) != 0)
+	{
+		// conversion of the lock isn't atomic, so another instance
+		// might have replaced data file before it's taken again.
+		flock(LockFD, LOCK_SH);
+		struct stat current, file;
+		if (fstat(DataFD, &current) == 0 && stat(dataPath().c_str(), &file) == 0
+		&&  (current.st_ino != file.st_ino || current.st_dev != file.st_dev))
+		{
+			::close(DataFD);
+			Index.clear();
+			DataSize = DeadSize = 0;
+			openDataFile();
+		}
+		return false;
+	}
+	bool result = replaceDataFile();
+	flock(LockFD, LOCK_SH);
+	return result;
+}
+
+bool replaceDataFile()
+{
+	// there are no other instances, but an interrupted
+	// one might have left some records to be picked up
+	catchUp();
+	std::string tmp = dataPath() + ".tmp";
+	int fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+	std::unordered_map<std::string, Entry> new_index;
+	new_index.reserve(Index.size());
+	uint64_t offset = 0;
+	bool ok = true;
+	std::string record;
+	for (auto it = Index.begin(); ok && it != Index.end(); ++it)
+	{
+		const Entry &e = it->second;
+		record.resize(recordSize(it->first.length(), e.StoredLength));
+		ok = readAt(DataFD, &record[0], record.length(), e.Offset)
+		&&   writeAll(fd, record.data(), record.length());
+		Entry &ne = new_index[it->first];
+		ne = e;
+		ne.Offset = offset;
+		offset += record.length();
+	}
+	ok = fsync(fd) == 0 && ok;
+	::close(fd);
+	if (!ok || rename(tmp.c_str(), dataPath().c_str()) != 0)
+	{
+		unlink(tmp.c_str());
+		return false;
+	}
+	::close(DataFD);
+	DataFD = ::open(dataPath().c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+	Index.swap(new_index);
+	DataSize = offset;
+	DeadSize = 0;
+	saveIndex();
+	return DataFD >= 0;
+}
+
+}
+
+bool LyricsStore::open(const std::string &directory)
+{
+	pthread_mutex_lock(&Lock);
+	if (DataFD < 0)
+	{
+		Directory = directory;
+		// lock has to be taken before data file is opened, so that
+		// it isn't replaced by another instance in the meantime
+		LockFD = ::open(lockPath().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+		if (LockFD >= 0 && flock(LockFD, LOCK_SH) == 0)
+			openDataFile();
+		if (DataFD < 0 && LockFD >= 0)
+		{
+			::close(LockFD);
+			LockFD = -1;
+		}
+	}
+	bool result = DataFD >= 0;
+	pthread_mutex_unlock(&Lock);
+	return result;
+}
+
+void LyricsStore::close()
+{
+	pthread_mutex_lock(&Lock);
+	if (DataFD >= 0)
+	{
+		if (DeadSize > DataSize/2)
+			compactUnlocked();
+		if (DataFD >= 0)
+		{
+			// index saved by this instance covers
+			// records appended by the other ones too
+			flock(DataFD, LOCK_EX);
+			catchUp();
+			saveIndex();
+			flock(DataFD, LOCK_UN);
+			::close(DataFD);
+			DataFD = -1;
+		}
+		::close(LockFD);
+		LockFD = -1;
+		Index.clear();
+		DataSize = DeadSize = 0;
+	}
+	pthread_mutex_unlock(&Lock);
+}
+
+bool LyricsStore::isOpen()
+{
+	pthread_mutex_lock(&Lock);
+	bool result = DataFD >= 0;
+	pthread_mutex_unlock(&Lock);
+	return result;
+}
+
+bool LyricsStore::contains(const std::string &key)
+{
+	pthread_mutex_lock(&Lock);
+	bool result = Index.find(key) != Index.end();
+	pthread_mutex_unlock(&Lock);
+	return result;
+}
+
+bool LyricsStore::get(const std::string &key, std::string &lyrics)
+{
+	bool result = false;
+	Entry e;
+	std::string stored;
+	pthread_mutex_lock(&Lock);
+	auto it = Index.find(key);
+	if (DataFD >= 0 && it != Index.end())
+	{
+		e = it->second;
+		result = readStored(key, e, stored);
+	}
+	pthread_mutex_unlock(&Lock);
+	return result && decode(stored, e, lyrics);
+}
+
+void LyricsStore::put(const std::string &key, const std::string &lyrics)
+{
+	std::string stored;
+	uint32_t flags;
+	encode(lyrics, stored, flags);
+	pthread_mutex_lock(&Lock);
+	if (DataFD >= 0)
+		append(key, stored, lyrics.length(), flags);
+	pthread_mutex_unlock(&Lock);
+}
+
+void LyricsStore::remove(const std::string &key)
+{
+	pthread_mutex_lock(&Lock);
+	if (DataFD >= 0 && Index.find(key) != Index.end())
+		append(key, "", 0, rfRemoved);
+	pthread_mutex_unlock(&Lock);
+}
+
+bool LyricsStore::compact()
+{
+	pthread_mutex_lock(&Lock);
+	bool result = DataFD >= 0 && compactUnlocked();
+	pthread_mutex_unlock(&Lock);
+	return result;
+}
+
+size_t LyricsStore::importFiles(const std::string &directory)
+{
+	size_t result = 0;
+	DIR *dir = opendir(directory.c_str());
+	if (!dir)
+		return result;
+	while (dirent *file = readdir(dir))
+	{
+		std::string name = file->d_name;
+		if (name.length() < 5 || name.compare(name.length()-4, 4, ".txt") != 0)
+			continue;
+		std::string path = directory + "/" + name;
+		std::ifstream input(path.c_str(), std::ios::binary);
+		if (!input.is_open())
+			continue;
+		std::string lyrics((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+		put(path, lyrics);
+		++result;
+	}
+	closedir(dir);
+	return result;
+}
+
+size_t LyricsStore::exportFiles()
+{
+	size_t result = 0;
+	std::vector<std::string> keys;
+	pthread_mutex_lock(&Lock);
+	keys.reserve(Index.size());
+	for (auto it = Index.begin(); it != Index.end(); ++it)
+		keys.push_back(it->first);
+	pthread_mutex_unlock(&Lock);
+	std::string lyrics;
+	for (auto key = keys.begin(); key != keys.end(); ++key)
+	{
+		if (!get(*key, lyrics))
+			continue;
+		std::ofstream output(key->c_str(), std::ios::binary);
+		if (output.is_open())
+		{
+			output << lyrics;
+			++result;
+		}
+	}
+	return result;
+}
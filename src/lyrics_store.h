@@ -0,0 +1,61 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2012 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#ifndef _LYRICS_STORE_H
+#define _LYRICS_STORE_H
+
+#include <string>
+
+/// Alternative to keeping lyrics of each song in a separate file. All
+/// lyrics are kept in one append-only data file (compressed if zlib is
+/// available) and located through an in-memory index, which is saved
+/// along with the data file, so it doesn't have to be rebuilt at startup.
+/// Lyrics are identified by the name of the file they would be saved in.
+/// All functions are thread safe.
+namespace LyricsStore {//
+
+/// opens the store located in given directory, creating it if needed
+bool open(const std::string &directory);
+
+/// saves the index, compacting the data file first
+/// if most of it is taken by outdated lyrics
+void close();
+
+bool isOpen();
+
+bool contains(const std::string &key);
+bool get(const std::string &key, std::string &lyrics);
+void put(const std::string &key, const std::string &lyrics);
+void remove(const std::string &key);
+
+/// rewrites data file without outdated and removed lyrics
+bool compact();
+
+/// imports all .txt files from given directory
+/// @return number of imported files
+size_t importFiles(const std::string &directory);
+
+/// writes all lyrics into the files they're identified by
+/// @return number of exported files
+size_t exportFiles();
+
+}
+
+#endif // _LYRICS_STORE_H
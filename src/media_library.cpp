@@ -22,6 +22,9 @@
 #include <utility>
 #include <array>
 #include <cassert>
+#include <deque>
+#include <map>
+#include <pthread.h>
 
 #include "charset.h"
 #include "display.h"
@@ -34,6 +37,7 @@
 #include "status.h"
 #include "statusbar.h"
 #include "utility/comparators.h"
+#include "utility/numeric_conversions.h"
 #include "utility/type_conversions.h"
 #include "title.h"
 #include "screen_switcher.h"
@@ -49,6 +53,7 @@ MediaLibrary *myLibrary;
 namespace {//
 
 bool hasTwoColumns;
+bool showRecentlyAdded;
 size_t itsLeftColStartX;
 size_t itsLeftColWidth;
 size_t itsMiddleColWidth;
@@ -133,12 +138,171 @@ public:
 	}
 };
 
+bool TagsEqual(const MPD::TagMTime &a, const MPD::TagMTime &b)
+{
+	return a.tag() == b.tag();
+}
+
+bool AlbumsEqual(const SearchConstraints &a, const SearchConstraints &b)
+{
+	return a.PrimaryTag == b.PrimaryTag && a.Album == b.Album && a.Date == b.Date;
+}
+
+// sorts items of the menu except given number of trailing ones
+// and puts the cursor back on the item it was on before sorting.
+template <typename T, typename CompareT, typename EqualT>
+void sortKeepingCursor(NC::Menu<T> &menu, size_t omitted, CompareT cmp, EqualT eq)
+{
+	if (menu.size() <= omitted)
+		return;
+	T current = menu.current().value();
+	std::sort(menu.beginV(), menu.endV()-omitted, cmp);
+	for (size_t i = 0; i < menu.size(); ++i)
+	{
+		if (!menu[i].isSeparator() && eq(menu[i].value(), current))
+		{
+			menu.highlight(i);
+			break;
+		}
+	}
+}
+
+// configuration values that affect fetched albums and songs. they are
+// captured at the time of scheduling so that prefetcher thread doesn't
+// depend on configuration being changed in the meantime.
+struct FetchParams
+{
+	FetchParams() : TagType(Config.media_lib_primary_tag),
+	                GetMTime(Config.media_library_sort_by_mtime),
+	                DisplayDate(Config.media_library_display_date) { }
+	
+	std::string albumsKey(const std::string &primary_tag) const;
+	std::string songsKey(const std::string &primary_tag, const SearchConstraints &sc) const;
+	
+	mpd_tag_type TagType;
+	bool GetMTime;
+	bool DisplayDate;
+};
+
+std::vector<SearchConstraints> fetchAlbums(MPD::Connection &mpd, const FetchParams &params,
+                                           const std::string &primary_tag);
+MPD::SongList fetchSongs(MPD::Connection &mpd, const FetchParams &params,
+                         const std::string &primary_tag, const SearchConstraints &sc);
+
+// fetches albums and songs for items adjacent to the cursor using separate
+// connection to mpd, so that they can be displayed immediately once cursor
+// lands on them.
+class Prefetcher
+{
+public:
+	struct Job
+	{
+		Job(const FetchParams &params_, const std::string &primary_tag)
+		: Params(params_), PrimaryTag(primary_tag), FetchAlbums(true) { }
+		Job(const FetchParams &params_, const std::string &primary_tag, const SearchConstraints &sc)
+		: Params(params_), PrimaryTag(primary_tag), Album(sc), FetchAlbums(false) { }
+		
+		FetchParams Params;
+		std::string PrimaryTag;
+		SearchConstraints Album;
+		bool FetchAlbums;
+	};
+	
+	Prefetcher();
+	
+	/// replaces pending jobs with given ones
+	void schedule(const std::vector<Job> &jobs);
+	
+	/// drops all prefetched items (and the ones being currently fetched)
+	void clear();
+	
+	/// @return true if albums/songs with given key were prefetched
+	bool getAlbums(const std::string &key, std::vector<SearchConstraints> &albums);
+	bool getSongs(const std::string &key, MPD::SongList &songs);
+	
+private:
+	static void *worker(void *data);
+	void process(const Job &job);
+	void waitFor(const std::string &key);
+	
+	template <typename MapT>
+	static void store(MapT &map, std::deque<std::string> &order,
+	                  const std::string &key, const typename MapT::mapped_type &value);
+	
+	static const size_t MaxItems = 16;
+	
+	pthread_t m_thread;
+	pthread_mutex_t m_lock;
+	pthread_cond_t m_job_available;
+	pthread_cond_t m_job_finished;
+	
+	MPD::Connection m_mpd;
+	std::string m_host;
+	int m_port;
+	std::string m_password;
+	bool m_running;
+	
+	// incremented on clear() so that results of jobs
+	// that were being processed at the time are discarded
+	unsigned m_generation;
+	
+	std::deque<Job> m_jobs;
+	std::string m_current_key;
+	
+	std::map<std::string, std::vector<SearchConstraints> > m_albums;
+	std::map<std::string, MPD::SongList> m_songs;
+	std::deque<std::string> m_albums_order;
+	std::deque<std::string> m_songs_order;
+};
+
+Prefetcher *prefetcher;
+
+// albums ordered by modification time of their newest song. it's built
+// with a single pass over the database and then updated by fetching only
+// songs modified after the newest known one, so that newest albums can be
+// selected without sorting (or even fetching) the whole library each time.
+class RecentlyAdded
+{
+public:
+	RecentlyAdded() : m_db_update(0), m_newest(0) { }
+	
+	/// @return at most count newest albums, newest first
+	std::vector<SearchConstraints> get(size_t count);
+	
+private:
+	struct Album
+	{
+		Album(const SearchConstraints &sc) : Constraints(sc), Songs(0) { }
+		
+		SearchConstraints Constraints;
+		size_t Songs;
+	};
+	
+	void sync();
+	void rebuild();
+	void add(const MPD::Song &s);
+	void clear();
+	
+	FetchParams m_params;
+	std::vector<Album> m_albums;
+	std::map<std::string, size_t> m_albums_index;
+	// maps uris of songs to albums they belong to
+	std::map<std::string, size_t> m_songs;
+	
+	unsigned long m_db_update;
+	time_t m_newest;
+};
+
+RecentlyAdded *recentlyAdded;
+
+void prefetchNeighbours();
 
 }
 
 MediaLibrary::MediaLibrary()
 {
 	hasTwoColumns = 0;
+	showRecentlyAdded = 0;
 	itsLeftColWidth = COLS/3-1;
 	itsMiddleColWidth = COLS/3;
 	itsMiddleColStartX = itsLeftColWidth+1;
@@ -170,6 +334,9 @@ MediaLibrary::MediaLibrary()
 	Songs.setItemDisplayer(std::bind(Display::Songs, _1, songsProxyList(), Config.song_library_format));
 	
 	w = &Tags;
+	
+	if (Config.media_library_prefetch)
+		prefetcher = new Prefetcher;
 }
 
 void MediaLibrary::resize()
@@ -231,16 +398,6 @@ std::wstring MediaLibrary::title()
 	return L"Media library";
 }
 
-bool MediaLibrary::hasMTimes()
-{
-	bool has = false;
-	if (hasTwoColumns && !Albums.empty())
-		has = Albums.current().value().hasMTime();
-	else if (!hasTwoColumns && !Tags.empty())
-		has = Tags.current().value().hasMTime();
-	return has;
-}
-
 void MediaLibrary::toggleMTimeSort()
 {
 	Config.media_library_sort_by_mtime = !Config.media_library_sort_by_mtime;
@@ -249,41 +406,120 @@ void MediaLibrary::toggleMTimeSort()
 	else
 		Statusbar::msg("Sorting library by: Name");
 
-	if (!myLibrary->hasMTimes() && Config.media_library_sort_by_mtime)
+	// mtimes are fetched along with the items only if they're sorted
+	// by them, so they're merged into loaded ones when they're needed
+	// for the first time. then loaded columns only need to be sorted.
+	if (Config.media_library_sort_by_mtime)
+		fetchMissingMTimes();
+	if (!hasTwoColumns)
+	{
+		sortKeepingCursor(Tags, 0, ArtistSorting(), TagsEqual);
+		Tags.refresh();
+	}
+	updateAlbumsTitle();
+	// recently added albums are always ordered by mtime
+	if (!showRecentlyAdded)
+	{
+		// omit separator and "All tracks" at the end
+		size_t omitted = !Albums.empty() && Albums.back().value().Date == AllTracksMarker ? 2 : 0;
+		sortKeepingCursor(Albums, omitted, SortSearchConstraints(), AlbumsEqual);
+	}
+	Albums.refresh();
+}
+
+void MediaLibrary::fetchMissingMTimes()
+{
+	Mpd.BlockIdle(true);
+	if (!hasTwoColumns && std::find_if(Tags.beginV(), Tags.endV(),
+	    [](const MPD::TagMTime &tm) { return !tm.hasMTime(); }) != Tags.endV())
+	{
+		auto list = Mpd.GetListMTime(Config.media_lib_primary_tag, true);
+		std::map<std::string, time_t> mtimes;
+		for (auto it = list.begin(); it != list.end(); ++it)
+			mtimes[it->tag()] = it->mtime();
+		withUnfilteredMenu(Tags, [this, &mtimes]() {
+			for (auto it = Tags.beginV(); it != Tags.endV(); ++it)
+			{
+				auto mt = mtimes.find(it->tag());
+				if (mt != mtimes.end())
+					it->set_mtime(mt->second);
+			}
+		});
+	}
+	// albums of the recently added list always have mtimes
+	if (!showRecentlyAdded)
+	{
+		withUnfilteredMenu(Albums, [this]() {
+			// album mtimes are fetched for each primary tag loaded albums belong to
+			std::map<std::string, std::map<std::string, time_t>> mtimes;
+			for (size_t i = 0; i < Albums.size(); ++i)
+			{
+				if (Albums[i].isSeparator())
+					continue;
+				SearchConstraints &sc = Albums[i].value();
+				if (sc.hasMTime() || sc.Date == AllTracksMarker)
+					continue;
+				const std::string &primary_tag = hasTwoColumns ? sc.PrimaryTag : Tags.current().value().tag();
+				auto albums = mtimes.find(primary_tag);
+				if (albums == mtimes.end())
+				{
+					albums = mtimes.insert(std::make_pair(primary_tag, std::map<std::string, time_t>())).first;
+					Mpd.StartFieldSearchMTime(MPD_TAG_ALBUM, true);
+					Mpd.AddSearch(Config.media_lib_primary_tag, primary_tag);
+					auto list = Mpd.CommitSearchTagsMTime();
+					for (auto it = list.begin(); it != list.end(); ++it)
+						albums->second[it->tag()] = it->mtime();
+				}
+				auto mt = albums->second.find(sc.Album);
+				if (mt != albums->second.end())
+					sc.MTime = mt->second;
+			}
+		});
+	}
+	Mpd.BlockIdle(false);
+}
+
+void MediaLibrary::toggleRecentlyAdded()
+{
+	showRecentlyAdded = !showRecentlyAdded;
+	if (showRecentlyAdded)
 	{
-		myLibrary->Tags.clear();
-		myLibrary->Albums.clear();
-		myLibrary->Songs.clear();
+		if (!recentlyAdded)
+			recentlyAdded = new RecentlyAdded;
+		Statusbar::msg("Showing recently added albums");
 	}
+	else
+		Statusbar::msg("Showing all albums");
+	
+	if (!hasTwoColumns)
+		toggleColumnsMode();
 	else
 	{
-		if (!hasTwoColumns)
-		{
-			std::sort(Tags.beginV(), Tags.endV(), ArtistSorting());
-			Tags.refresh();
-			Albums.clear();
-			Songs.clear();
-		}
-		else
-		{
-			std::sort(Albums.beginV(), Albums.endV(), SortSearchConstraints());
-			Albums.refresh();
-			Songs.clear();
-		}
+		Albums.clear();
+		Albums.reset();
+		Songs.clear();
+		if (isActiveWindow(Songs))
+			previousColumn();
+		updateAlbumsTitle();
 	}
+}
 
-	if (hasTwoColumns)
+void MediaLibrary::updateAlbumsTitle()
+{
+	if (!Config.titles_visibility)
+		Albums.setTitle("");
+	else if (!hasTwoColumns)
+		Albums.setTitle("Albums");
+	else if (showRecentlyAdded)
+		Albums.setTitle("Albums (recently added)");
+	else
 	{
-		if (Config.titles_visibility)
-		{
-			std::string item_type = lowercase(tagTypeToString(Config.media_lib_primary_tag));
-			std::string and_mtime = Config.media_library_sort_by_mtime ?
-			                        " and mtime" :
-			                        "";
-			Albums.setTitle("Albums (sorted by " + item_type + and_mtime + ")");
-		}
+		std::string item_type = lowercase(tagTypeToString(Config.media_lib_primary_tag));
+		std::string and_mtime = Config.media_library_sort_by_mtime ?
+		                        " and mtime" :
+		                        "";
+		Albums.setTitle("Albums (sorted by " + item_type + and_mtime + ")");
 	}
-	myLibrary->update();
 }
 
 void MediaLibrary::update()
@@ -305,34 +541,26 @@ void MediaLibrary::update()
 		Tags.refresh();
 	}
 	
+	bool fetched = false;
+	
 	if (!hasTwoColumns && !Tags.empty() && Albums.reallyEmpty() && Songs.reallyEmpty())
 	{
-		// idle has to be blocked for now since it would be enabled and
-		// disabled a few times by each mpd command, which makes no sense
-		// and slows down the whole process.
-		Mpd.BlockIdle(true);
 		Albums.reset();
-		Mpd.StartFieldSearchMTime(MPD_TAG_ALBUM, Config.media_library_sort_by_mtime);
-		Mpd.AddSearch(Config.media_lib_primary_tag, Tags.current().value().tag());
-		auto albums = Mpd.CommitSearchTagsMTime();
-		for (auto tagmtime = albums.begin(); tagmtime != albums.end(); ++tagmtime)
+		FetchParams params;
+		const std::string &primary_tag = Tags.current().value().tag();
+		std::vector<SearchConstraints> albums;
+		if (!Config.media_library_prefetch
+		||  !prefetcher->getAlbums(params.albumsKey(primary_tag), albums))
 		{
-			const std::string &album = tagmtime->tag();
-			time_t mtime = tagmtime->mtime();
-			if (Config.media_library_display_date)
-			{
-				Mpd.StartFieldSearch(MPD_TAG_DATE);
-
-				Mpd.AddSearch(Config.media_lib_primary_tag,
-				              Tags.current().value().tag());
-				Mpd.AddSearch(MPD_TAG_ALBUM, album);
-				auto dates = Mpd.CommitSearchTags();
-				for (auto date = dates.begin(); date != dates.end(); ++date)
-					Albums.addItem(SearchConstraints(album, *date, mtime));
-			}
-			else
-				Albums.addItem(SearchConstraints(album, "", mtime));
+			// idle has to be blocked for now since it would be enabled and
+			// disabled a few times by each mpd command, which makes no sense
+			// and slows down the whole process.
+			Mpd.BlockIdle(true);
+			albums = fetchAlbums(Mpd, params, primary_tag);
+			Mpd.BlockIdle(false);
 		}
+		for (auto album = albums.begin(); album != albums.end(); ++album)
+			Albums.addItem(*album);
 		if (!Albums.empty())
 			std::sort(Albums.beginV(), Albums.endV(), SortSearchConstraints());
 		if (Albums.size() > 1)
@@ -341,7 +569,17 @@ void MediaLibrary::update()
 			Albums.addItem(SearchConstraints("", AllTracksMarker));
 		}
 		Albums.refresh();
-		Mpd.BlockIdle(false);
+		fetched = true;
+	}
+	else if (hasTwoColumns && showRecentlyAdded && Albums.reallyEmpty())
+	{
+		Songs.clear();
+		Albums << NC::XY(0, 0) << "Fetching albums...";
+		Albums.Window::refresh();
+		auto albums = recentlyAdded->get(Config.media_library_recently_added_count);
+		for (auto album = albums.begin(); album != albums.end(); ++album)
+			Albums.addItem(*album);
+		Albums.refresh();
 	}
 	else if (hasTwoColumns && Albums.reallyEmpty())
 	{
@@ -395,17 +633,14 @@ void MediaLibrary::update()
 	{
 		Songs.reset();
 		
-		Mpd.StartSearch(1);
-		Mpd.AddSearch(Config.media_lib_primary_tag,
-		              hasTwoColumns ? Albums.current().value().PrimaryTag :
-		                              Tags.current().value().tag());
-		if (Albums.current().value().Date != AllTracksMarker)
-		{
-			Mpd.AddSearch(MPD_TAG_ALBUM, Albums.current().value().Album);
-			if (Config.media_library_display_date)
-				Mpd.AddSearch(MPD_TAG_DATE, Albums.current().value().Date);
-		}
-		auto songs = Mpd.CommitSearchSongs();
+		FetchParams params;
+		const std::string &primary_tag = hasTwoColumns
+		                               ? Albums.current().value().PrimaryTag
+		                               : Tags.current().value().tag();
+		MPD::SongList songs;
+		if (!Config.media_library_prefetch
+		||  !prefetcher->getSongs(params.songsKey(primary_tag, Albums.current().value()), songs))
+			songs = fetchSongs(Mpd, params, primary_tag, Albums.current().value());
 		for (auto s = songs.begin(); s != songs.end(); ++s)
 			Songs.addItem(*s, myPlaylist->checkForSong(*s));
 		
@@ -415,7 +650,17 @@ void MediaLibrary::update()
 			std::sort(Songs.beginV(), Songs.endV(), SortSongsByTrack);
 		
 		Songs.refresh();
+		fetched = true;
 	}
+	
+	if (fetched && Config.media_library_prefetch)
+		prefetchNeighbours();
+}
+
+void MediaLibrary::clearPrefetched()
+{
+	if (prefetcher)
+		prefetcher->clear();
 }
 
 void MediaLibrary::enterPressed()
@@ -702,7 +947,8 @@ MPD::SongList MediaLibrary::getSelectedSongs()
 					Mpd.AddSearch(Config.media_lib_primary_tag,
 					              Tags.current().value().tag());
 				Mpd.AddSearch(MPD_TAG_ALBUM, sc.Album);
-				Mpd.AddSearch(MPD_TAG_DATE, sc.Date);
+				if (Config.media_library_display_date)
+					Mpd.AddSearch(MPD_TAG_DATE, sc.Date);
 				auto songs = Mpd.CommitSearchSongs();
 				std::sort(songs.begin(), songs.end(), SortSongsByTrack);
 				result.insert(result.end(), songs.begin(), songs.end());
@@ -728,6 +974,76 @@ MPD::SongList MediaLibrary::getSelectedSongs()
 	return result;
 }
 
+bool MediaLibrary::allowsServerSideAdding()
+{
+	// findadd is available since mpd 0.16
+	if (Mpd.Version() < 16)
+		return false;
+	if (isActiveWindow(Tags))
+		return !Tags.empty();
+	else if (isActiveWindow(Albums))
+	{
+		// without selected albums songs from right column are
+		// added and their order has to be preserved.
+		for (auto it = Albums.begin(); it != Albums.end() && !it->isSeparator(); ++it)
+			if (it->isSelected())
+				return true;
+	}
+	return false;
+}
+
+bool MediaLibrary::addSelectedSongs(bool play)
+{
+	assert(allowsServerSideAdding());
+	// songs are added in the order of database, which
+	// is usually the same as the one of track numbers.
+	size_t position = Mpd.GetPlaylistLength();
+	Mpd.StartCommandsList();
+	if (isActiveWindow(Tags))
+	{
+		auto tag_handler = [](const std::string &tag) {
+			Mpd.StartSearchAdd();
+			Mpd.AddSearch(Config.media_lib_primary_tag, tag);
+			Mpd.CommitSearchAdd();
+		};
+		bool any_selected = false;
+		for (auto it = Tags.begin(); it != Tags.end(); ++it)
+		{
+			if (it->isSelected())
+			{
+				tag_handler(it->value().tag());
+				any_selected = true;
+			}
+		}
+		// if no item is selected, add current one
+		if (!any_selected)
+			tag_handler(Tags.current().value().tag());
+	}
+	else if (isActiveWindow(Albums))
+	{
+		for (auto it = Albums.begin(); it != Albums.end() && !it->isSeparator(); ++it)
+		{
+			if (it->isSelected())
+			{
+				auto &sc = it->value();
+				Mpd.StartSearchAdd();
+				if (hasTwoColumns)
+					Mpd.AddSearch(Config.media_lib_primary_tag, sc.PrimaryTag);
+				else
+					Mpd.AddSearch(Config.media_lib_primary_tag,
+					              Tags.current().value().tag());
+				Mpd.AddSearch(MPD_TAG_ALBUM, sc.Album);
+				if (Config.media_library_display_date)
+					Mpd.AddSearch(MPD_TAG_DATE, sc.Date);
+				Mpd.CommitSearchAdd();
+			}
+		}
+	}
+	if (play)
+		Mpd.Play(position);
+	return Mpd.CommitCommandsList();
+}
+
 /***********************************************************************/
 
 bool MediaLibrary::previousColumnAvailable()
@@ -803,27 +1119,15 @@ void MediaLibrary::nextColumn()
 void MediaLibrary::toggleColumnsMode()
 {
 	hasTwoColumns = !hasTwoColumns;
+	if (!hasTwoColumns)
+		showRecentlyAdded = false;
 	Tags.clear();
 	Albums.clear();
 	Albums.reset();
 	Songs.clear();
-	if (hasTwoColumns)
-	{
-		if (isActiveWindow(Tags))
-			nextColumn();
-		if (Config.titles_visibility)
-		{
-			std::string item_type = lowercase(tagTypeToString(Config.media_lib_primary_tag));
-			std::string and_mtime = Config.media_library_sort_by_mtime ?
-			                        " and mtime" :
-									"";
-			Albums.setTitle("Albums (sorted by " + item_type + and_mtime + ")");
-		}
-		else
-			Albums.setTitle("");
-	}
-	else
-		Albums.setTitle(Config.titles_visibility ? "Albums" : "");
+	if (hasTwoColumns && isActiveWindow(Tags))
+		nextColumn();
+	updateAlbumsTitle();
 	resize();
 }
 
@@ -875,6 +1179,9 @@ void MediaLibrary::LocateSong(const MPD::Song &s)
 	
 	if (myScreen != this)
 		switchTo();
+	// song may not belong to any of recently added albums
+	if (showRecentlyAdded)
+		toggleRecentlyAdded();
 	Statusbar::put() << "Jumping to song...";
 	Global::wFooter->refresh();
 	
@@ -950,8 +1257,12 @@ void MediaLibrary::AddToPlaylist(bool add_n_play)
 		addSongToPlaylist(Songs.current().value(), add_n_play);
 	else
 	{
-		auto list = getSelectedSongs();
-		if (addSongsToPlaylist(list, add_n_play))
+		bool success;
+		if (allowsServerSideAdding())
+			success = addSelectedSongs(add_n_play);
+		else
+			success = addSongsToPlaylist(getSelectedSongs(), add_n_play);
+		if (success)
 		{
 			if ((!Tags.empty() && isActiveWindow(Tags))
 			||  (isActiveWindow(Albums) && Albums.current().value().Date == AllTracksMarker))
@@ -1052,6 +1363,409 @@ bool SortSongsByTrack(const MPD::Song &a, const MPD::Song &b)
 	return a.getTrack() < b.getTrack();
 }
 
+/***********************************************************************/
+
+std::string FetchParams::albumsKey(const std::string &primary_tag) const
+{
+	// mpd protocol is line based, so newlines can't appear in tags
+	std::string result = "albums\n";
+	result += intTo<std::string>::apply(TagType);
+	result += GetMTime ? "\nmtime\n" : "\n\n";
+	result += DisplayDate ? "date\n" : "\n";
+	result += primary_tag;
+	return result;
+}
+
+std::string FetchParams::songsKey(const std::string &primary_tag, const SearchConstraints &sc) const
+{
+	std::string result = "songs\n";
+	result += intTo<std::string>::apply(TagType);
+	result += DisplayDate ? "\ndate\n" : "\n\n";
+	result += primary_tag;
+	result += '\n';
+	result += sc.Album;
+	result += '\n';
+	result += sc.Date;
+	return result;
+}
+
+std::vector<SearchConstraints> fetchAlbums(MPD::Connection &mpd, const FetchParams &params,
+                                           const std::string &primary_tag)
+{
+	std::vector<SearchConstraints> result;
+	mpd.StartFieldSearchMTime(MPD_TAG_ALBUM, params.GetMTime);
+	mpd.AddSearch(params.TagType, primary_tag);
+	auto albums = mpd.CommitSearchTagsMTime();
+	for (auto tagmtime = albums.begin(); tagmtime != albums.end(); ++tagmtime)
+	{
+		const std::string &album = tagmtime->tag();
+		time_t mtime = tagmtime->mtime();
+		if (params.DisplayDate)
+		{
+			mpd.StartFieldSearch(MPD_TAG_DATE);
+			mpd.AddSearch(params.TagType, primary_tag);
+			mpd.AddSearch(MPD_TAG_ALBUM, album);
+			auto dates = mpd.CommitSearchTags();
+			for (auto date = dates.begin(); date != dates.end(); ++date)
+				result.push_back(SearchConstraints(album, *date, mtime));
+		}
+		else
+			result.push_back(SearchConstraints(album, "", mtime));
+	}
+	return result;
+}
+
+MPD::SongList fetchSongs(MPD::Connection &mpd, const FetchParams &params,
+                         const std::string &primary_tag, const SearchConstraints &sc)
+{
+	mpd.StartSearch(1);
+	mpd.AddSearch(params.TagType, primary_tag);
+	if (sc.Date != AllTracksMarker)
+	{
+		mpd.AddSearch(MPD_TAG_ALBUM, sc.Album);
+		if (params.DisplayDate)
+			mpd.AddSearch(MPD_TAG_DATE, sc.Date);
+	}
+	return mpd.CommitSearchSongs();
+}
+
+void prefetchNeighbours()
+{
+	FetchParams params;
+	std::vector<Prefetcher::Job> jobs;
+	auto &Tags = myLibrary->Tags;
+	auto &Albums = myLibrary->Albums;
+	// songs of adjacent albums go first as user is most
+	// likely to be browsing albums if songs were fetched
+	if (!Albums.empty() && !myLibrary->isActiveWindow(Tags))
+	{
+		size_t pos = Albums.choice();
+		const std::string &primary_tag = hasTwoColumns || Tags.empty()
+		                               ? std::string()
+		                               : Tags.current().value().tag();
+		for (int offset = -1; offset <= 1; offset += 2)
+		{
+			size_t i = pos+offset;
+			if (i >= Albums.size() || Albums[i].isSeparator())
+				continue;
+			const SearchConstraints &sc = Albums[i].value();
+			jobs.push_back(Prefetcher::Job(params, hasTwoColumns ? sc.PrimaryTag : primary_tag, sc));
+		}
+	}
+	if (!hasTwoColumns && !Tags.empty())
+	{
+		size_t pos = Tags.choice();
+		for (int offset = -1; offset <= 1; offset += 2)
+		{
+			size_t i = pos+offset;
+			if (i < Tags.size())
+				jobs.push_back(Prefetcher::Job(params, Tags[i].value().tag()));
+		}
+	}
+	prefetcher->schedule(jobs);
+}
+
+/***********************************************************************/
+
+Prefetcher::Prefetcher() : m_port(0), m_running(false), m_generation(0)
+{
+	pthread_mutex_init(&m_lock, 0);
+	pthread_cond_init(&m_job_available, 0);
+	pthread_cond_init(&m_job_finished, 0);
+	m_mpd.SetTimeout(Config.mpd_connection_timeout);
+	// this connection is used only for searching,
+	// so there is no need to listen for events.
+	m_mpd.SetIdleEnabled(false);
+}
+
+void Prefetcher::schedule(const std::vector<Job> &jobs)
+{
+	pthread_mutex_lock(&m_lock);
+	// password might have been changed since the last time
+	m_host = Mpd.GetHostname();
+	m_port = Mpd.GetPort();
+	m_password = Mpd.GetPassword();
+	m_jobs.assign(jobs.begin(), jobs.end());
+	if (!m_running)
+	{
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		m_running = !pthread_create(&m_thread, &attr, worker, this);
+		pthread_attr_destroy(&attr);
+	}
+	pthread_cond_signal(&m_job_available);
+	pthread_mutex_unlock(&m_lock);
+}
+
+void Prefetcher::clear()
+{
+	pthread_mutex_lock(&m_lock);
+	++m_generation;
+	m_jobs.clear();
+	m_albums.clear();
+	m_songs.clear();
+	m_albums_order.clear();
+	m_songs_order.clear();
+	pthread_mutex_unlock(&m_lock);
+}
+
+bool Prefetcher::getAlbums(const std::string &key, std::vector<SearchConstraints> &albums)
+{
+	pthread_mutex_lock(&m_lock);
+	waitFor(key);
+	auto it = m_albums.find(key);
+	bool found = it != m_albums.end();
+	if (found)
+		albums = it->second;
+	pthread_mutex_unlock(&m_lock);
+	return found;
+}
+
+bool Prefetcher::getSongs(const std::string &key, MPD::SongList &songs)
+{
+	pthread_mutex_lock(&m_lock);
+	waitFor(key);
+	auto it = m_songs.find(key);
+	bool found = it != m_songs.end();
+	if (found)
+		songs = it->second;
+	pthread_mutex_unlock(&m_lock);
+	return found;
+}
+
+void Prefetcher::waitFor(const std::string &key)
+{
+	// if requested item is being fetched right now, it's
+	// faster to wait for it than to start fetching it again
+	while (m_current_key == key)
+		pthread_cond_wait(&m_job_finished, &m_lock);
+}
+
+void *Prefetcher::worker(void *data)
+{
+	Prefetcher *p = static_cast<Prefetcher *>(data);
+	pthread_mutex_lock(&p->m_lock);
+	while (true)
+	{
+		while (p->m_jobs.empty())
+			pthread_cond_wait(&p->m_job_available, &p->m_lock);
+		Job job = p->m_jobs.front();
+		p->m_jobs.pop_front();
+		p->m_current_key = job.FetchAlbums
+		                 ? job.Params.albumsKey(job.PrimaryTag)
+		                 : job.Params.songsKey(job.PrimaryTag, job.Album);
+		bool already_fetched = job.FetchAlbums
+		                     ? p->m_albums.find(p->m_current_key) != p->m_albums.end()
+		                     : p->m_songs.find(p->m_current_key) != p->m_songs.end();
+		if (!already_fetched)
+		{
+			pthread_mutex_unlock(&p->m_lock);
+			p->process(job);
+			pthread_mutex_lock(&p->m_lock);
+		}
+		p->m_current_key.clear();
+		pthread_cond_broadcast(&p->m_job_finished);
+	}
+	return 0;
+}
+
+void Prefetcher::process(const Job &job)
+{
+	// mpd closes connections that were inactive for too long,
+	// so if it happened, try again with a fresh connection.
+	for (int attempt = 0; attempt < 2; ++attempt)
+	{
+		pthread_mutex_lock(&m_lock);
+		unsigned generation = m_generation;
+		if (!m_mpd.Connected())
+		{
+			m_mpd.SetHostname(m_host);
+			m_mpd.SetPort(m_port);
+			m_mpd.SetPassword(m_password);
+		}
+		pthread_mutex_unlock(&m_lock);
+		
+		if (!m_mpd.Connected() && !m_mpd.Connect())
+			return;
+		
+		if (job.FetchAlbums)
+		{
+			auto albums = fetchAlbums(m_mpd, job.Params, job.PrimaryTag);
+			if (!m_mpd.Connected())
+				continue;
+			// songs of the first album are displayed right after
+			// albums are, so fetch them along with albums.
+			std::sort(albums.begin(), albums.end(), SortSearchConstraints());
+			MPD::SongList songs;
+			if (!albums.empty())
+			{
+				songs = fetchSongs(m_mpd, job.Params, job.PrimaryTag, albums.front());
+				if (!m_mpd.Connected())
+					continue;
+			}
+			pthread_mutex_lock(&m_lock);
+			if (generation == m_generation)
+			{
+				store(m_albums, m_albums_order, job.Params.albumsKey(job.PrimaryTag), albums);
+				if (!albums.empty())
+					store(m_songs, m_songs_order, job.Params.songsKey(job.PrimaryTag, albums.front()), songs);
+			}
+			pthread_mutex_unlock(&m_lock);
+		}
+		else
+		{
+			auto songs = fetchSongs(m_mpd, job.Params, job.PrimaryTag, job.Album);
+			if (!m_mpd.Connected())
+				continue;
+			pthread_mutex_lock(&m_lock);
+			if (generation == m_generation)
+				store(m_songs, m_songs_order, job.Params.songsKey(job.PrimaryTag, job.Album), songs);
+			pthread_mutex_unlock(&m_lock);
+		}
+		return;
+	}
+}
+
+template <typename MapT>
+void Prefetcher::store(MapT &map, std::deque<std::string> &order,
+                       const std::string &key, const typename MapT::mapped_type &value)
+{
+	if (map.find(key) == map.end())
+	{
+		order.push_back(key);
+		if (order.size() > MaxItems)
+		{
+			map.erase(order.front());
+			order.pop_front();
+		}
+	}
+	map[key] = value;
+}
+
+/***********************************************************************/
+
+std::vector<SearchConstraints> RecentlyAdded::get(size_t count)
+{
+	std::vector<SearchConstraints> result;
+	sync();
+	if (count == 0)
+		return result;
+	
+	// keep count newest albums in a heap with the oldest
+	// of them on top, so that it can be quickly replaced.
+	auto newer = [](const Album *a, const Album *b) {
+		return a->Constraints.MTime > b->Constraints.MTime;
+	};
+	std::vector<const Album *> heap;
+	heap.reserve(std::min(count, m_albums.size()));
+	for (auto album = m_albums.begin(); album != m_albums.end(); ++album)
+	{
+		if (album->Songs == 0)
+			continue;
+		if (heap.size() < count)
+		{
+			heap.push_back(&*album);
+			std::push_heap(heap.begin(), heap.end(), newer);
+		}
+		else if (newer(&*album, heap.front()))
+		{
+			std::pop_heap(heap.begin(), heap.end(), newer);
+			heap.back() = &*album;
+			std::push_heap(heap.begin(), heap.end(), newer);
+		}
+	}
+	std::sort_heap(heap.begin(), heap.end(), newer);
+	
+	result.reserve(heap.size());
+	for (auto album = heap.begin(); album != heap.end(); ++album)
+		result.push_back((*album)->Constraints);
+	return result;
+}
+
+void RecentlyAdded::sync()
+{
+	MPD::Statistics stats = Mpd.getStatistics();
+	if (stats.empty())
+		return;
+	
+	FetchParams params;
+	if (params.TagType != m_params.TagType || params.DisplayDate != m_params.DisplayDate)
+	{
+		clear();
+		m_params = params;
+	}
+	if (!m_albums.empty() && m_db_update == stats.dbUpdateTime())
+		return;
+	
+	// filtering songs by modification time is supported since mpd 0.19
+	if (m_albums.empty() || Mpd.Version() < 19)
+		rebuild();
+	else
+	{
+		auto songs = Mpd.GetSongsModifiedSince(m_newest);
+		for (auto s = songs.begin(); s != songs.end(); ++s)
+			add(*s);
+		// songs were removed or added with older modification
+		// time, there is no way to find out which ones.
+		if (m_songs.size() != stats.songs())
+			rebuild();
+	}
+	m_db_update = stats.dbUpdateTime();
+}
+
+void RecentlyAdded::rebuild()
+{
+	clear();
+	auto songs = Mpd.GetSongsModifiedSince(0);
+	for (auto s = songs.begin(); s != songs.end(); ++s)
+		add(*s);
+}
+
+void RecentlyAdded::add(const MPD::Song &s)
+{
+	std::string primary_tag = s.getTag(m_params.TagType);
+	std::string date;
+	if (m_params.DisplayDate)
+		date = m_params.TagType == MPD_TAG_DATE ? primary_tag : s.getDate();
+	SearchConstraints sc(primary_tag, s.getAlbum(), date, s.getMTime());
+	
+	std::string key = sc.PrimaryTag;
+	key += '\n';
+	key += sc.Album;
+	key += '\n';
+	key += sc.Date;
+	auto it = m_albums_index.find(key);
+	if (it == m_albums_index.end())
+	{
+		it = m_albums_index.insert(std::make_pair(key, m_albums.size())).first;
+		m_albums.push_back(Album(sc));
+	}
+	Album &album = m_albums[it->second];
+	album.Constraints.MTime = std::max(album.Constraints.MTime, sc.MTime);
+	m_newest = std::max(m_newest, sc.MTime);
+	
+	auto song = m_songs.insert(std::make_pair(s.getURI(), it->second));
+	if (!song.second)
+	{
+		// song was modified, it could have been moved to another album
+		if (song.first->second == it->second)
+			return;
+		--m_albums[song.first->second].Songs;
+		song.first->second = it->second;
+	}
+	++album.Songs;
+}
+
+void RecentlyAdded::clear()
+{
+	m_albums.clear();
+	m_albums_index.clear();
+	m_songs.clear();
+	m_db_update = 0;
+	m_newest = 0;
+}
+
 
 
 }
@@ -61,6 +61,9 @@ struct MediaLibrary: Screen<NC::Window *>, Filterable, HasColumns, HasSongs, Sea
 	virtual void reverseSelection() OVERRIDE;
 	virtual MPD::SongList getSelectedSongs() OVERRIDE;
 	
+	virtual bool allowsServerSideAdding() OVERRIDE;
+	virtual bool addSelectedSongs(bool play) OVERRIDE;
+	
 	// HasColumns implementation
 	virtual bool previousColumnAvailable() OVERRIDE;
 	virtual void previousColumn() OVERRIDE;
@@ -75,8 +78,14 @@ struct MediaLibrary: Screen<NC::Window *>, Filterable, HasColumns, HasSongs, Sea
 	ProxySongList songsProxyList();
 
 	// mtimes
-	bool hasMTimes();
 	void toggleMTimeSort();
+	void fetchMissingMTimes();
+	void toggleRecentlyAdded();
+	
+	void updateAlbumsTitle();
+	
+	// drops albums and songs fetched in background
+	void clearPrefetched();
 
 	struct SearchConstraints
 	{
@@ -93,8 +102,8 @@ struct MediaLibrary: Screen<NC::Window *>, Filterable, HasColumns, HasSongs, Sea
 		time_t MTime;
 	
 		bool operator<(const SearchConstraints &a) const;
-
-		bool hasMTime() { return MTime != 0; }
+		
+		bool hasMTime() const { return MTime != 0; }
 	};
 
 	NC::Menu<MPD::TagMTime> Tags;
@@ -19,17 +19,136 @@
  ***************************************************************************/
 
 #include <cassert>
+#include <cmath>
 #include <cstdlib>
 #include <algorithm>
+#include <functional>
 #include <map>
 #include <cstring>
 
 #include "charset.h"
 #include "error.h"
 #include "mpdpp.h"
+#include "utility/numeric_conversions.h"
 
 MPD::Connection Mpd;
 
+namespace {//
+
+// separates parts of the key of cached search. mpd protocol is
+// line based, so newline can't appear in any tag or constraint.
+const char SearchKeySeparator = '\n';
+
+// sizes of cached results are only estimated since songs hold their
+// tags in mpd_song structures we can't look into. uri length plus
+// a constant for the rest of the tags is close enough.
+size_t estimateSize(const MPD::SongList &list)
+{
+	size_t result = sizeof(MPD::Song)*list.capacity();
+	for (auto it = list.begin(); it != list.end(); ++it)
+		result += it->getURI().length() + 256;
+	return result;
+}
+
+size_t estimateSize(const MPD::StringList &list)
+{
+	size_t result = sizeof(std::string)*list.capacity();
+	for (auto it = list.begin(); it != list.end(); ++it)
+		result += it->capacity();
+	return result;
+}
+
+size_t estimateSize(const MPD::TagMTimeList &list)
+{
+	size_t result = sizeof(MPD::TagMTime)*list.capacity();
+	for (auto it = list.begin(); it != list.end(); ++it)
+		result += it->tag().capacity();
+	return result;
+}
+
+// picks number distinct indices out of [0, size) with equal
+// probability using Floyd's algorithm, so that only number
+// random values are needed regardless of size.
+std::vector<size_t> sampleUniform(size_t size, size_t number)
+{
+	assert(number <= size);
+	std::vector<size_t> result;
+	std::set<size_t> chosen;
+	result.reserve(number);
+	for (size_t j = size-number; j < size; ++j)
+	{
+		size_t t = rand()%(j+1);
+		if (!chosen.insert(t).second)
+		{
+			t = j;
+			chosen.insert(t);
+		}
+		result.push_back(t);
+	}
+	// order of chosen indices isn't uniformly random
+	std::random_shuffle(result.begin(), result.end());
+	return result;
+}
+
+// picks number distinct indices out of [0, size) with probability
+// proportional to their weights in a single pass (weighted reservoir
+// sampling by Efraimidis and Spirakis). each index gets a key equal
+// to u^(1/weight), where u is uniformly random in (0, 1), and ones
+// with the largest keys are kept in a heap. logarithms of keys are
+// compared instead since they have the same order.
+template <typename WeightFunction>
+std::vector<size_t> sampleWeighted(size_t size, size_t number, WeightFunction weight)
+{
+	assert(number <= size);
+	typedef std::pair<double, size_t> Key;
+	std::vector<Key> heap;
+	heap.reserve(number);
+	// the smallest key is on top
+	std::greater<Key> cmp;
+	for (size_t i = 0; i < size; ++i)
+	{
+		double u = (rand()+1.0)/(RAND_MAX+2.0);
+		Key key(log(u)/weight(i), i);
+		if (heap.size() < number)
+		{
+			heap.push_back(key);
+			std::push_heap(heap.begin(), heap.end(), cmp);
+		}
+		else if (cmp(key, heap.front()))
+		{
+			std::pop_heap(heap.begin(), heap.end(), cmp);
+			heap.back() = key;
+			std::push_heap(heap.begin(), heap.end(), cmp);
+		}
+	}
+	std::vector<size_t> result;
+	result.reserve(heap.size());
+	for (auto it = heap.begin(); it != heap.end(); ++it)
+		result.push_back(it->second);
+	std::random_shuffle(result.begin(), result.end());
+	return result;
+}
+
+// weight halves with each recency_half_life days since last
+// modification, but never drops to zero, so that old items
+// can still be chosen.
+struct RecencyWeight
+{
+	RecencyWeight(unsigned half_life) : m_now(time(0)), m_half_life(half_life*86400.0) { }
+	
+	double operator()(time_t mtime) const
+	{
+		double age = std::max(0.0, difftime(m_now, mtime));
+		return std::max(pow(0.5, age/m_half_life), 1e-6);
+	}
+	
+private:
+	time_t m_now;
+	double m_half_life;
+};
+
+}
+
 namespace MPD {//
 
 bool Statistics::empty() const
@@ -82,14 +201,22 @@ unsigned long Statistics::dbPlayTime() const
 Connection::Connection() : itsConnection(0),
 				isCommandsListEnabled(0),
 				isIdle(0),
+				isIdleEnabled(0),
+				itsIdleBlocked(0),
 				supportsIdle(0),
+				hasData(0),
 				itsHost("localhost"),
 				itsPort(6600),
 				itsTimeout(15),
 				itsCurrentStatus(0),
 				itsOldStatus(0),
 				itsUpdater(0),
-				itsErrorHandler(0)
+				itsErrorHandler(0),
+				itsSearchCacheLimit(0),
+				itsSearchCacheUsage(0),
+				itsSearchCacheHits(0),
+				itsSearchCacheMisses(0),
+				itsSearchCacheDBUpdateTime(0)
 {
 }
 
@@ -114,6 +241,14 @@ bool Connection::Connect()
 		SendPassword();
 	itsFD = mpd_connection_get_fd(itsConnection);
 	supportsIdle = isIdleEnabled && Version() > 13;
+	// results cached before reconnection are still valid
+	// only if database didn't change in the meantime
+	if (itsSearchCacheLimit)
+	{
+		Statistics stats = getStatistics();
+		if (!stats.empty())
+			CheckDBUpdateTime(stats.dbUpdateTime());
+	}
 	// in UpdateStatus() we compare it to itsElapsedTimer[0],
 	// and for the first time it has always evaluate to true
 	// so we need it to be zero at this point
@@ -167,6 +302,12 @@ bool Connection::SendPassword()
 	return !CheckForErrors();
 }
 
+void Connection::SetSearchCacheSize(size_t size)
+{
+	itsSearchCacheLimit = size;
+	ShrinkSearchCache(itsSearchCacheLimit);
+}
+
 void Connection::SetStatusUpdater(StatusUpdater updater, void *data)
 {
 	itsUpdater = updater;
@@ -198,11 +339,19 @@ int Connection::GoBusy()
 	return flags;
 }
 
+size_t Connection::GetStatusRequestsPerMinute() const
+{
+	time_t minute_ago = time(0)-60;
+	return itsStatusTimes.end()-std::upper_bound(itsStatusTimes.begin(), itsStatusTimes.end(), minute_ago);
+}
+
 Statistics Connection::getStatistics()
 {
 	assert(itsConnection);
 	GoBusy();
 	mpd_stats *stats = mpd_run_stats(itsConnection);
+	if (stats)
+		CheckDBUpdateTime(mpd_stats_get_db_update_time(stats));
 	return Statistics(stats);
 }
 
@@ -257,6 +406,11 @@ void Connection::UpdateStatus()
 	
 	itsCurrentStatus = mpd_run_status(itsConnection);
 	
+	time_t now = time(0);
+	while (!itsStatusTimes.empty() && itsStatusTimes.front() <= now-60)
+		itsStatusTimes.pop_front();
+	itsStatusTimes.push_back(now);
+	
 	if (CheckForErrors())
 		return;
 	
@@ -331,6 +485,9 @@ void Connection::UpdateStatus()
 				itsChanges.Outputs = 0;
 			}
 			
+			if (itsChanges.Database)
+				InvalidateSearchCache();
+			
 			itsChanges.SongID = mpd_status_get_song_id(itsOldStatus)
 					 != mpd_status_get_song_id(itsCurrentStatus);
 			
@@ -944,70 +1101,117 @@ bool Connection::Add(const std::string &path)
 	}
 }
 
-bool Connection::AddRandomTag(mpd_tag_type tag, size_t number)
+bool Connection::AddRandomTag(mpd_tag_type tag, size_t number, unsigned recency_half_life)
 {
-	if (!itsConnection && !number)
+	if (!itsConnection || !number)
 		return false;
 	assert(!isCommandsListEnabled);
 	
-	auto tags = GetList(tag);
-	if (number > tags.size())
+	// both lists are kept in search cache
+	StringList tags;
+	std::vector<size_t> chosen;
+	if (recency_half_life)
 	{
-		if (itsErrorHandler)
-			itsErrorHandler(this, 0, "Requested number is out of range", itsErrorHandlerUserdata);
-		return false;
+		auto list = GetListMTime(tag, true);
+		if (number <= list.size())
+		{
+			RecencyWeight weight(recency_half_life);
+			chosen = sampleWeighted(list.size(), number, [&](size_t i) {
+				return weight(list[i].mtime());
+			});
+			for (auto it = chosen.begin(); it != chosen.end(); ++it)
+				tags.push_back(list[*it].tag());
+		}
 	}
 	else
 	{
-		std::random_shuffle(tags.begin(), tags.end());
-		auto it = tags.begin()+rand()%(tags.size()-number);
-		for (size_t i = 0; i < number && it != tags.end(); ++i)
+		auto list = GetList(tag);
+		if (number <= list.size())
 		{
-			StartSearch(1);
-			AddSearch(tag, *it++);
-			auto songs = CommitSearchSongs();
-			StartCommandsList();
-			for (auto s = songs.begin(); s != songs.end(); ++s)
-				AddSong(*s);
-			CommitCommandsList();
+			chosen = sampleUniform(list.size(), number);
+			for (auto it = chosen.begin(); it != chosen.end(); ++it)
+				tags.push_back(list[*it]);
 		}
 	}
-	return true;
+	
+	if (tags.empty())
+	{
+		if (itsErrorHandler)
+			itsErrorHandler(this, 0, "Requested number is out of range", itsErrorHandlerUserdata);
+		return false;
+	}
+	StartCommandsList();
+	for (auto it = tags.begin(); it != tags.end(); ++it)
+	{
+		StartSearchAdd();
+		AddSearch(tag, *it);
+		CommitSearchAdd();
+	}
+	return CommitCommandsList();
 }
 
-bool Connection::AddRandomSongs(size_t number)
+bool Connection::AddRandomSongs(size_t number, unsigned recency_half_life)
 {
-	if (!itsConnection && !number)
+	if (!itsConnection || !number)
 		return false;
 	assert(!isCommandsListEnabled);
 	
-	StringList files;
-	
-	GoBusy();
-	mpd_send_list_all(itsConnection, "/");
-	while (mpd_pair *item = mpd_recv_pair_named(itsConnection, "file"))
-	{
-		files.push_back(item->value);
-		mpd_return_pair(itsConnection, item);
-	}
-	mpd_response_finish(itsConnection);
+	if (itsRandomFiles.empty() || (recency_half_life && itsRandomFilesMTime.empty()))
+		FetchRandomFiles(recency_half_life);
 	
-	if (number > files.size())
+	if (number > itsRandomFiles.size())
 	{
 		if (itsErrorHandler)
 			itsErrorHandler(this, 0, "Requested number of random songs is bigger than size of your library", itsErrorHandlerUserdata);
 		return false;
 	}
+	
+	std::vector<size_t> chosen;
+	if (recency_half_life)
+	{
+		RecencyWeight weight(recency_half_life);
+		chosen = sampleWeighted(itsRandomFiles.size(), number, [&](size_t i) {
+			return weight(itsRandomFilesMTime[i]);
+		});
+	}
+	else
+		chosen = sampleUniform(itsRandomFiles.size(), number);
+	StartCommandsList();
+	for (auto it = chosen.begin(); it != chosen.end(); ++it)
+		AddSong(itsRandomFiles[*it]);
+	return CommitCommandsList();
+}
+
+void Connection::FetchRandomFiles(bool with_mtime)
+{
+	itsRandomFiles.clear();
+	itsRandomFilesMTime.clear();
+	GoBusy();
+	if (with_mtime)
+	{
+		mpd_send_list_all_meta(itsConnection, "/");
+		while (mpd_song *s = mpd_recv_song(itsConnection))
+		{
+			itsRandomFiles.push_back(mpd_song_get_uri(s));
+			itsRandomFilesMTime.push_back(mpd_song_get_last_modified(s));
+			mpd_song_free(s);
+		}
+	}
 	else
 	{
-		std::random_shuffle(files.begin(), files.end());
-		StartCommandsList();
-		auto it = files.begin()+rand()%(std::max(size_t(1), files.size()-number));
-		for (size_t i = 0; i < number && it != files.end(); ++i, ++it)
-			AddSong(*it);
-		CommitCommandsList();
+		mpd_send_list_all(itsConnection, "/");
+		while (mpd_pair *item = mpd_recv_pair_named(itsConnection, "file"))
+		{
+			itsRandomFiles.push_back(item->value);
+			mpd_return_pair(itsConnection, item);
+		}
+	}
+	// don't keep incomplete list around
+	if (!mpd_response_finish(itsConnection))
+	{
+		itsRandomFiles.clear();
+		itsRandomFilesMTime.clear();
 	}
-	return true;
 }
 
 bool Connection::Delete(unsigned pos)
@@ -1134,6 +1338,11 @@ StringList Connection::GetList(mpd_tag_type type)
 	if (!itsConnection)
 		return result;
 	assert(!isCommandsListEnabled);
+	std::string key = "list";
+	key += SearchKeySeparator;
+	key += intTo<std::string>::apply(type);
+	if (const SearchCacheEntry *cached = FindInSearchCache(key))
+		return cached->tags;
 	GoBusy();
 	mpd_search_db_tags(itsConnection, type);
 	mpd_search_commit(itsConnection);
@@ -1142,7 +1351,12 @@ StringList Connection::GetList(mpd_tag_type type)
 		result.push_back(item->value);
 		mpd_return_pair(itsConnection, item);
 	}
-	mpd_response_finish(itsConnection);
+	if (mpd_response_finish(itsConnection))
+	{
+		SearchCacheEntry entry;
+		entry.tags = result;
+		AddToSearchCache(key, std::move(entry));
+	}
 	GoIdle();
 	return result;
 }
@@ -1154,6 +1368,11 @@ TagMTimeList Connection::GetListMTime(mpd_tag_type type, bool get_mtime)
 	if (!itsConnection)
 		return result;
 	assert(!isCommandsListEnabled);
+	std::string key = get_mtime ? "list_mtime" : "list_tags";
+	key += SearchKeySeparator;
+	key += intTo<std::string>::apply(type);
+	if (const SearchCacheEntry *cached = FindInSearchCache(key))
+		return cached->tags_mtime;
 	GoBusy();
 
 	if (!get_mtime)
@@ -1189,7 +1408,13 @@ TagMTimeList Connection::GetListMTime(mpd_tag_type type, bool get_mtime)
 			result.push_back(TagMTime(it->first, it->second));
 		}
 	}
-
+	
+	if (mpd_connection_get_error(itsConnection) == MPD_ERROR_SUCCESS)
+	{
+		SearchCacheEntry entry;
+		entry.tags_mtime = result;
+		AddToSearchCache(key, std::move(entry));
+	}
 	GoIdle();
 	return result;
 }
@@ -1198,7 +1423,10 @@ TagMTimeList Connection::GetListMTime(mpd_tag_type type, bool get_mtime)
 void Connection::StartSearch(bool exact_match)
 {
 	if (itsConnection)
+	{
+		itsSearchKey = exact_match ? "songs_exact" : "songs";
 		mpd_search_db_songs(itsConnection, exact_match);
+	}
 }
 
 void Connection::StartFieldSearch(mpd_tag_type item)
@@ -1206,6 +1434,9 @@ void Connection::StartFieldSearch(mpd_tag_type item)
 	if (itsConnection)
 	{
 		itsSearchedField = item;
+		itsSearchKey = "tags";
+		itsSearchKey += SearchKeySeparator;
+		itsSearchKey += intTo<std::string>::apply(item);
 		mpd_search_db_tags(itsConnection, item);
 	}
 }
@@ -1215,6 +1446,9 @@ void Connection::StartFieldSearchMTime(mpd_tag_type item, bool get_mtime)
 	{
 		itsSearchedField = item;
 		itsSearchFieldMTime = get_mtime;
+		itsSearchKey = get_mtime ? "tags_mtime" : "tags_no_mtime";
+		itsSearchKey += SearchKeySeparator;
+		itsSearchKey += intTo<std::string>::apply(item);
 		if (!get_mtime)
 			mpd_search_db_tags(itsConnection, item);
 		else
@@ -1222,27 +1456,53 @@ void Connection::StartFieldSearchMTime(mpd_tag_type item, bool get_mtime)
 	}
 }
 
-void Connection::AddSearch(mpd_tag_type item, const std::string &str) const
+void Connection::StartSearchAdd()
+{
+	if (itsConnection)
+	{
+		// results are never cached, but constraints are appended to the key anyway
+		itsSearchKey = "add";
+		mpd_search_add_db_songs(itsConnection, true);
+	}
+}
+
+void Connection::AddSearch(mpd_tag_type item, const std::string &str)
 {
 	// mpd version < 0.14.* doesn't support empty search constraints
 	if (Version() < 14 && str.empty())
 		return;
 	if (itsConnection)
+	{
+		itsSearchKey += SearchKeySeparator;
+		itsSearchKey += intTo<std::string>::apply(item);
+		itsSearchKey += '=';
+		itsSearchKey += str;
 		mpd_search_add_tag_constraint(itsConnection, MPD_OPERATOR_DEFAULT, item, str.c_str());
+	}
 }
 
-void Connection::AddSearchAny(const std::string &str) const
+void Connection::AddSearchAny(const std::string &str)
 {
 	assert(!str.empty());
 	if (itsConnection)
+	{
+		itsSearchKey += SearchKeySeparator;
+		itsSearchKey += "any=";
+		itsSearchKey += str;
 		mpd_search_add_any_tag_constraint(itsConnection, MPD_OPERATOR_DEFAULT, str.c_str());
+	}
 }
 
-void Connection::AddSearchURI(const std::string &str) const
+void Connection::AddSearchURI(const std::string &str)
 {
 	assert(!str.empty());
 	if (itsConnection)
+	{
+		itsSearchKey += SearchKeySeparator;
+		itsSearchKey += "uri=";
+		itsSearchKey += str;
 		mpd_search_add_uri_constraint(itsConnection, MPD_OPERATOR_DEFAULT, str.c_str());
+	}
 }
 
 SongList Connection::CommitSearchSongs()
@@ -1251,11 +1511,21 @@ SongList Connection::CommitSearchSongs()
 	if (!itsConnection)
 		return result;
 	assert(!isCommandsListEnabled);
+	if (const SearchCacheEntry *cached = FindInSearchCache(itsSearchKey))
+	{
+		mpd_search_cancel(itsConnection);
+		return cached->songs;
+	}
 	GoBusy();
 	mpd_search_commit(itsConnection);
 	while (mpd_song *s = mpd_recv_song(itsConnection))
 		result.push_back(Song(s));
-	mpd_response_finish(itsConnection);
+	if (mpd_response_finish(itsConnection))
+	{
+		SearchCacheEntry entry;
+		entry.songs = result;
+		AddToSearchCache(itsSearchKey, std::move(entry));
+	}
 	GoIdle();
 	return result;
 }
@@ -1266,6 +1536,11 @@ StringList Connection::CommitSearchTags()
 	if (!itsConnection)
 		return result;
 	assert(!isCommandsListEnabled);
+	if (const SearchCacheEntry *cached = FindInSearchCache(itsSearchKey))
+	{
+		mpd_search_cancel(itsConnection);
+		return cached->tags;
+	}
 	GoBusy();
 	mpd_search_commit(itsConnection);
 	while (mpd_pair *tag = mpd_recv_pair_tag(itsConnection, itsSearchedField))
@@ -1273,7 +1548,12 @@ StringList Connection::CommitSearchTags()
 		result.push_back(tag->value);
 		mpd_return_pair(itsConnection, tag);
 	}
-	mpd_response_finish(itsConnection);
+	if (mpd_response_finish(itsConnection))
+	{
+		SearchCacheEntry entry;
+		entry.tags = result;
+		AddToSearchCache(itsSearchKey, std::move(entry));
+	}
 	GoIdle();
 	return result;
 }
@@ -1285,6 +1565,11 @@ TagMTimeList Connection::CommitSearchTagsMTime()
 		return result;
 
 	assert(!isCommandsListEnabled);
+	if (const SearchCacheEntry *cached = FindInSearchCache(itsSearchKey))
+	{
+		mpd_search_cancel(itsConnection);
+		return cached->tags_mtime;
+	}
 	GoBusy();
 	mpd_search_commit(itsConnection);
 
@@ -1316,12 +1601,42 @@ TagMTimeList Connection::CommitSearchTagsMTime()
 			result.push_back(TagMTime(it->first, it->second));
 		}
 	}
-	mpd_response_finish(itsConnection);
+	if (mpd_response_finish(itsConnection))
+	{
+		SearchCacheEntry entry;
+		entry.tags_mtime = result;
+		AddToSearchCache(itsSearchKey, std::move(entry));
+	}
 	GoIdle();
 
 	return result;
 }
 
+bool Connection::CommitSearchAdd()
+{
+	if (!itsConnection)
+		return false;
+	if (!isCommandsListEnabled)
+	{
+		GoBusy();
+		return mpd_search_commit(itsConnection) && mpd_response_finish(itsConnection);
+	}
+	else
+	{
+		assert(!isIdle);
+		return mpd_search_commit(itsConnection);
+	}
+}
+
+void Connection::InvalidateSearchCache()
+{
+	itsSearchCache.clear();
+	itsSearchCacheIndex.clear();
+	itsSearchCacheUsage = 0;
+	itsRandomFiles.clear();
+	itsRandomFilesMTime.clear();
+}
+
 
 ItemList Connection::GetDirectory(const std::string &path)
 {
@@ -1374,6 +1689,28 @@ SongList Connection::GetDirectoryRecursive(const std::string &path)
 	return result;
 }
 
+SongList Connection::GetSongsModifiedSince(time_t since)
+{
+	SongList result;
+	if (!itsConnection)
+		return result;
+	assert(!isCommandsListEnabled);
+	assert(since == 0 || Version() > 18);
+	GoBusy();
+	if (since > 0)
+	{
+		std::string since_str = intTo<std::string>::apply(since);
+		mpd_send_command(itsConnection, "find", "modified-since", since_str.c_str(), NULL);
+	}
+	else
+		mpd_send_list_all_meta(itsConnection, "/");
+	while (mpd_song *s = mpd_recv_song(itsConnection))
+		result.push_back(Song(s));
+	mpd_response_finish(itsConnection);
+	GoIdle();
+	return result;
+}
+
 StringList Connection::GetDirectories(const std::string &path)
 {
 	StringList result;
@@ -1493,6 +1830,66 @@ StringList Connection::GetTagTypes()
 	return result;
 }
 
+const Connection::SearchCacheEntry *Connection::FindInSearchCache(const std::string &key)
+{
+	if (!itsSearchCacheLimit)
+		return 0;
+	auto it = itsSearchCacheIndex.find(key);
+	if (it == itsSearchCacheIndex.end())
+	{
+		++itsSearchCacheMisses;
+		return 0;
+	}
+	++itsSearchCacheHits;
+	// move found entry to the front so it will be evicted last
+	itsSearchCache.splice(itsSearchCache.begin(), itsSearchCache, it->second);
+	return &it->second->second;
+}
+
+void Connection::AddToSearchCache(const std::string &key, SearchCacheEntry entry)
+{
+	if (!itsSearchCacheLimit)
+		return;
+	entry.size = key.capacity()
+	           + estimateSize(entry.songs)
+	           + estimateSize(entry.tags)
+	           + estimateSize(entry.tags_mtime);
+	// don't let one huge result wipe out the whole cache
+	if (entry.size > itsSearchCacheLimit/2)
+		return;
+	auto it = itsSearchCacheIndex.find(key);
+	if (it != itsSearchCacheIndex.end())
+	{
+		itsSearchCacheUsage -= it->second->second.size;
+		itsSearchCache.erase(it->second);
+		itsSearchCacheIndex.erase(it);
+	}
+	ShrinkSearchCache(itsSearchCacheLimit-entry.size);
+	itsSearchCacheUsage += entry.size;
+	itsSearchCache.push_front(std::make_pair(key, std::move(entry)));
+	itsSearchCacheIndex[key] = itsSearchCache.begin();
+}
+
+void Connection::ShrinkSearchCache(size_t limit)
+{
+	while (itsSearchCacheUsage > limit)
+	{
+		assert(!itsSearchCache.empty());
+		itsSearchCacheUsage -= itsSearchCache.back().second.size;
+		itsSearchCacheIndex.erase(itsSearchCache.back().first);
+		itsSearchCache.pop_back();
+	}
+}
+
+void Connection::CheckDBUpdateTime(unsigned long db_update_time)
+{
+	if (db_update_time != itsSearchCacheDBUpdateTime)
+	{
+		InvalidateSearchCache();
+		itsSearchCacheDBUpdateTime = db_update_time;
+	}
+}
+
 int Connection::CheckForErrors()
 {
 	int error_code = MPD_ERROR_SUCCESS;
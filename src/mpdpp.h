@@ -22,6 +22,9 @@
 #define _MPDPP_H
 
 #include <cassert>
+#include <deque>
+#include <list>
+#include <map>
 #include <set>
 #include <vector>
 
@@ -114,7 +117,7 @@ struct TagMTime
 		m_tag = tag_;
 	}
 
-	bool hasMTime()
+	bool hasMTime() const
 	{
 		return (m_mtime != 0);
 	}
@@ -168,6 +171,8 @@ public:
 	void SetPort(int port) { itsPort = port; }
 	void SetTimeout(int timeout) { itsTimeout = timeout; }
 	void SetPassword(const std::string &password) { itsPassword = password; }
+	const std::string &GetPassword() const { return itsPassword; }
+	void SetSearchCacheSize(size_t size);
 	bool SendPassword();
 	
 	Statistics getStatistics();
@@ -208,6 +213,11 @@ public:
 	int GetTotalTime() const { return itsCurrentStatus ? mpd_status_get_total_time(itsCurrentStatus) : 0; }
 	unsigned GetBitrate() const { return itsCurrentStatus ? mpd_status_get_kbit_rate(itsCurrentStatus) : 0; }
 	
+	/// @return time when status was fetched from mpd for the last time
+	time_t GetStatusTime() const { return itsStatusTimes.empty() ? 0 : itsStatusTimes.back(); }
+	/// @return number of times status was fetched during the last minute
+	size_t GetStatusRequestsPerMinute() const;
+	
 	size_t GetPlaylistLength() const { return itsCurrentStatus ? mpd_status_get_queue_length(itsCurrentStatus) : 0; }
 	SongList GetPlaylistChanges(unsigned);
 	
@@ -216,6 +226,7 @@ public:
 	Song GetCurrentlyPlayingSong();
 	int GetCurrentlyPlayingSongPos() const;
 	int GetCurrentSongPos() const;
+	int GetNextSongPos() const { return itsCurrentStatus ? mpd_status_get_next_song_pos(itsCurrentStatus) : -1; }
 	Song GetSong(const std::string &);
 	SongList GetPlaylistContent(const std::string &);
 	
@@ -235,8 +246,10 @@ public:
 	
 	int AddSong(const std::string &, int = -1); // returns id of added song
 	int AddSong(const Song &, int = -1); // returns id of added song
-	bool AddRandomTag(mpd_tag_type, size_t);
-	bool AddRandomSongs(size_t);
+	// if recency_half_life (in days) is non-zero, recently modified
+	// items are more likely to be chosen than the older ones.
+	bool AddRandomTag(mpd_tag_type, size_t, unsigned recency_half_life = 0);
+	bool AddRandomSongs(size_t, unsigned recency_half_life = 0);
 	bool Add(const std::string &path);
 	bool Delete(unsigned);
 	bool DeleteID(unsigned);
@@ -256,18 +269,26 @@ public:
 	void StartSearch(bool);
 	void StartFieldSearch(mpd_tag_type);
 	void StartFieldSearchMTime(mpd_tag_type, bool);
-	void AddSearch(mpd_tag_type, const std::string &) const;
-	void AddSearchAny(const std::string &str) const;
-	void AddSearchURI(const std::string &str) const;
+	void StartSearchAdd();
+	void AddSearch(mpd_tag_type, const std::string &);
+	void AddSearchAny(const std::string &str);
+	void AddSearchURI(const std::string &str);
 	SongList CommitSearchSongs();
 	StringList CommitSearchTags();
 	TagMTimeList CommitSearchTagsMTime();
+	bool CommitSearchAdd();
+	
+	void InvalidateSearchCache();
+	size_t GetSearchCacheHits() const { return itsSearchCacheHits; }
+	size_t GetSearchCacheMisses() const { return itsSearchCacheMisses; }
+	size_t GetSearchCacheUsage() const { return itsSearchCacheUsage; }
 	
 	StringList GetPlaylists();
 	StringList GetList(mpd_tag_type);
 	TagMTimeList GetListMTime(mpd_tag_type, bool);
 	ItemList GetDirectory(const std::string &);
 	SongList GetDirectoryRecursive(const std::string &);
+	SongList GetSongsModifiedSince(time_t since);
 	SongList GetSongs(const std::string &);
 	StringList GetDirectories(const std::string &);
 	
@@ -281,10 +302,28 @@ public:
 private:
 	//void check
 	
+	// results of searches/lists that are kept until database changes.
+	// only one of the lists is filled, depending on the type of query.
+	struct SearchCacheEntry
+	{
+		SongList songs;
+		StringList tags;
+		TagMTimeList tags_mtime;
+		size_t size;
+	};
+	typedef std::list< std::pair<std::string, SearchCacheEntry> > SearchCache;
+	
 	void GoIdle();
 	int GoBusy();
 	
 	int CheckForErrors();
+	
+	const SearchCacheEntry *FindInSearchCache(const std::string &key);
+	void AddToSearchCache(const std::string &key, SearchCacheEntry entry);
+	void ShrinkSearchCache(size_t limit);
+	void CheckDBUpdateTime(unsigned long db_update_time);
+	
+	void FetchRandomFiles(bool with_mtime);
 
 	mpd_connection *itsConnection;
 	bool isCommandsListEnabled;
@@ -309,6 +348,9 @@ private:
 	unsigned itsElapsed;
 	time_t itsElapsedTimer[2];
 	
+	// times of status requests during the last minute
+	std::deque<time_t> itsStatusTimes;
+	
 	StatusChanges itsChanges;
 	
 	StatusUpdater itsUpdater;
@@ -318,6 +360,24 @@ private:
 	
 	mpd_tag_type itsSearchedField;
 	bool itsSearchFieldMTime;
+	
+	// key of search that is currently being built, it consists
+	// of the search type and all constraints added so far.
+	std::string itsSearchKey;
+	
+	// most recently used entries are at the front
+	SearchCache itsSearchCache;
+	std::map<std::string, SearchCache::iterator> itsSearchCacheIndex;
+	size_t itsSearchCacheLimit;
+	size_t itsSearchCacheUsage;
+	size_t itsSearchCacheHits;
+	size_t itsSearchCacheMisses;
+	unsigned long itsSearchCacheDBUpdateTime;
+	
+	// uris of all songs in database (and their mtimes if they were
+	// needed) used for choosing random songs, dropped with search cache.
+	StringList itsRandomFiles;
+	std::vector<time_t> itsRandomFilesMTime;
 };
 
 }
@@ -166,6 +166,19 @@ void MutableSong::setDuration(unsigned int duration)
 	m_duration = duration;
 }
 
+time_t MutableSong::getMTime() const
+{
+	if (m_mtime > 0)
+		return m_mtime;
+	else
+		return Song::getMTime();
+}
+
+void MutableSong::setMTime(time_t mtime)
+{
+	m_mtime = mtime;
+}
+
 void MutableSong::setTags(SetFunction set, const std::string &value, const std::string &delimiter)
 {
 	auto tags = split(value, delimiter);
@@ -30,8 +30,8 @@ struct MutableSong : public Song
 {
 	typedef void (MutableSong::*SetFunction)(const std::string &, unsigned);
 	
-	MutableSong() : m_duration(0) { }
-	MutableSong(Song s) : Song(s), m_duration(0) { }
+	MutableSong() : m_duration(0), m_mtime(0) { }
+	MutableSong(Song s) : Song(s), m_duration(0), m_mtime(0) { }
 	
 	virtual std::string getArtist(unsigned idx = 0) const;
 	virtual std::string getTitle(unsigned idx = 0) const;
@@ -63,6 +63,9 @@ struct MutableSong : public Song
 	virtual unsigned getDuration() const;
 	void setDuration(unsigned duration);
 	
+	virtual time_t getMTime() const;
+	void setMTime(time_t mtime);
+	
 	void setTags(SetFunction set, const std::string &value, const std::string &delimiter);
 	
 	bool isModified() const;
@@ -104,6 +107,7 @@ private:
 	
 	std::string m_uri;
 	unsigned m_duration;
+	time_t m_mtime;
 	std::map<Tag, std::string> m_tags;
 };
 
@@ -37,12 +37,16 @@
 #include "global.h"
 #include "helpers.h"
 #include "lyrics.h"
+#include "lyrics_store.h"
 #include "playlist.h"
 #include "settings.h"
 #include "status.h"
 #include "statusbar.h"
+#include "tags.h"
 #include "visualizer.h"
+#include "timers.h"
 #include "title.h"
+#include "workers.h"
 
 namespace
 {
@@ -69,6 +73,10 @@ namespace
 		std::cerr.rdbuf(cerr_buffer);
 		errorlog.close();
 		Mpd.Disconnect();
+#		ifdef HAVE_TAGLIB_H
+		Tags::saveCache();
+#		endif // HAVE_TAGLIB_H
+		LyricsStore::close();
 #		ifndef USE_PDCURSES // destroying screen somehow crashes pdcurses
 		NC::destroyScreen();
 #		endif // USE_PDCURSES
@@ -114,8 +122,19 @@ int main(int argc, char **argv)
 		Mpd.SetPort(Config.mpd_port);
 	
 	Mpd.SetTimeout(Config.mpd_connection_timeout);
+	Mpd.SetSearchCacheSize(size_t(Config.search_cache_size)*1024*1024);
 	Mpd.SetIdleEnabled(Config.enable_idle_notifications);
 	
+#	ifdef HAVE_TAGLIB_H
+	Tags::setCacheSize(Config.tag_cache_size);
+#	endif // HAVE_TAGLIB_H
+	
+	if (Config.lyrics_store)
+	{
+		CreateDir(Config.lyrics_directory);
+		LyricsStore::open(Config.lyrics_directory);
+	}
+	
 	if (argc > 1)
 		ParseArgv(argc, argv);
 	
@@ -157,10 +176,15 @@ int main(int argc, char **argv)
 		wHeader->display();
 	
 	wFooter = new NC::Window(0, Action::FooterStartY, COLS, Action::FooterHeight, "", Config.statusbar_color, NC::brNone);
-	wFooter->setTimeout(500);
+	// if timers are available, main loop sleeps until there is
+	// something to do, otherwise it wakes up regularly.
+	wFooter->setTimeout(Timers::fd() >= 0 ? -1 : 500);
 	wFooter->setGetStringHelper(Statusbar::Helpers::getString);
 	if (Mpd.SupportsIdle())
 		wFooter->addFDCallback(Mpd.GetFD(), Statusbar::Helpers::mpd);
+	wFooter->addFDCallback(Workers::fd(), Workers::processResults);
+	if (Timers::fd() >= 0)
+		wFooter->addFDCallback(Timers::fd(), Timers::processExpired);
 	wFooter->createHistory();
 	
 	// initialize global timer
@@ -205,7 +229,12 @@ int main(int argc, char **argv)
 		if (!Mpd.Connected())
 		{
 			if (!wFooter->FDCallbacksListEmpty())
+			{
 				wFooter->clearFDCallbacksList();
+				wFooter->addFDCallback(Workers::fd(), Workers::processResults);
+				if (Timers::fd() >= 0)
+					wFooter->addFDCallback(Timers::fd(), Timers::processExpired);
+			}
 			Statusbar::msg("Attempting to reconnect...");
 			if (Mpd.Connect())
 			{
@@ -223,6 +252,8 @@ int main(int argc, char **argv)
 				myVisualizer->FindOutputID();
 #				endif // ENABLE_VISUALIZER
 			}
+			else
+				Timers::wakeUpAfter(500);
 		}
 		
 		Status::trace();
@@ -268,15 +299,6 @@ int main(int argc, char **argv)
 		
 		if (myScreen == myPlaylist)
 			myPlaylist->EnableHighlighting();
-		
-#		ifdef ENABLE_VISUALIZER
-		// visualizer sets timeout to 40ms, but since only it needs such small
-		// value, we should restore defalt one after switching to another screen.
-		if (wFooter->getTimeout() < 500
-		&&  !(myScreen == myVisualizer || myLockedScreen == myVisualizer || myInactiveScreen == myVisualizer)
-		   )
-			wFooter->setTimeout(500);
-#		endif // ENABLE_VISUALIZER
 	}
 	return 0;
 }
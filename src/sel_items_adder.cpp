@@ -19,6 +19,7 @@
  ***************************************************************************/
 
 #include <algorithm>
+#include <cassert>
 
 #include "browser.h"
 #include "global.h"
@@ -108,12 +109,19 @@ void SelectedItemsAdder::switchTo()
 	if (!hs || !hs->allowsSelection())
 		return;
 	
-	Statusbar::msg(1, "Fetching selected songs...");
-	m_selected_items = hs->getSelectedSongs();
-	if (m_selected_items.empty())
+	m_selected_items.clear();
+	// if selected items can be added at the end of current playlist without
+	// fetching them, postpone that until they are needed somewhere else.
+	m_server_side_adding = hs->allowsServerSideAdding();
+	if (!m_server_side_adding)
 	{
-		Statusbar::msg("List of selected items is empty");
-		return;
+		Statusbar::msg(1, "Fetching selected songs...");
+		m_selected_items = hs->getSelectedSongs();
+		if (m_selected_items.empty())
+		{
+			Statusbar::msg("List of selected items is empty");
+			return;
+		}
 	}
 	populatePlaylistSelector(myScreen);
 	SwitchTo::execute(this);
@@ -221,7 +229,7 @@ void SelectedItemsAdder::addToCurrentPlaylist()
 	m_position_selector.reset();
 }
 
-void SelectedItemsAdder::addToNewPlaylist() const
+void SelectedItemsAdder::addToNewPlaylist()
 {
 	Statusbar::lock();
 	Statusbar::put() << "Save playlist as: ";
@@ -231,10 +239,11 @@ void SelectedItemsAdder::addToNewPlaylist() const
 		addToExistingPlaylist(playlist);
 }
 
-void SelectedItemsAdder::addToExistingPlaylist(const std::string &playlist) const
+void SelectedItemsAdder::addToExistingPlaylist(const std::string &playlist)
 {
+	const MPD::SongList &items = selectedItems();
 	Mpd.StartCommandsList();
-	for (auto s = m_selected_items.begin(); s != m_selected_items.end(); ++s)
+	for (auto s = items.begin(); s != items.end(); ++s)
 		Mpd.AddToPlaylist(playlist, *s);
 	if (Mpd.CommitCommandsList())
 	{
@@ -243,32 +252,36 @@ void SelectedItemsAdder::addToExistingPlaylist(const std::string &playlist) cons
 	}
 }
 
-void SelectedItemsAdder::addAtTheEndOfPlaylist() const
+void SelectedItemsAdder::addAtTheEndOfPlaylist()
 {
-	bool success = addSongsToPlaylist(m_selected_items, false);
+	bool success;
+	if (m_server_side_adding)
+		success = hasSongs(previousScreen())->addSelectedSongs(false);
+	else
+		success = addSongsToPlaylist(selectedItems(), false);
 	if (success)
 		exitSuccessfully();
 }
 
-void SelectedItemsAdder::addAtTheBeginningOfPlaylist() const
+void SelectedItemsAdder::addAtTheBeginningOfPlaylist()
 {
-	bool success = addSongsToPlaylist(m_selected_items, false, 0);
+	bool success = addSongsToPlaylist(selectedItems(), false, 0);
 	if (success)
 		exitSuccessfully();
 }
 
-void SelectedItemsAdder::addAfterCurrentSong() const
+void SelectedItemsAdder::addAfterCurrentSong()
 {
 	if (!Mpd.isPlaying())
 		return;
 	size_t pos = Mpd.GetCurrentlyPlayingSongPos();
 	++pos;
-	bool success = addSongsToPlaylist(m_selected_items, false, pos);
+	bool success = addSongsToPlaylist(selectedItems(), false, pos);
 	if (success)
 		exitSuccessfully();
 }
 
-void SelectedItemsAdder::addAfterCurrentAlbum() const
+void SelectedItemsAdder::addAfterCurrentAlbum()
 {
 	if (!Mpd.isPlaying())
 		return;
@@ -279,16 +292,16 @@ void SelectedItemsAdder::addAfterCurrentAlbum() const
 		while (pos < pl.size() && pl[pos].value().getAlbum() == album)
 			++pos;
 	});
-	bool success = addSongsToPlaylist(m_selected_items, false, pos);
+	bool success = addSongsToPlaylist(selectedItems(), false, pos);
 	if (success)
 		exitSuccessfully();
 }
 
-void SelectedItemsAdder::addAfterHighlightedSong() const
+void SelectedItemsAdder::addAfterHighlightedSong()
 {
 	size_t pos = myPlaylist->main().current().value().getPosition();
 	++pos;
-	bool success = addSongsToPlaylist(m_selected_items, false, pos);
+	bool success = addSongsToPlaylist(selectedItems(), false, pos);
 	if (success)
 		exitSuccessfully();
 }
@@ -307,6 +320,18 @@ void SelectedItemsAdder::exitSuccessfully() const
 	switchToPreviousScreen();
 }
 
+const MPD::SongList &SelectedItemsAdder::selectedItems()
+{
+	if (m_selected_items.empty())
+	{
+		auto hs = hasSongs(previousScreen());
+		assert(hs);
+		Statusbar::msg(1, "Fetching selected songs...");
+		m_selected_items = hs->getSelectedSongs();
+	}
+	return m_selected_items;
+}
+
 void SelectedItemsAdder::setDimensions()
 {
 	using Global::MainHeight;
@@ -54,16 +54,18 @@ private:
 	void populatePlaylistSelector(BaseScreen *screen);
 	
 	void addToCurrentPlaylist();
-	void addToNewPlaylist() const;
-	void addToExistingPlaylist(const std::string &playlist) const;
-	void addAtTheEndOfPlaylist() const;
-	void addAtTheBeginningOfPlaylist() const;
-	void addAfterCurrentSong() const;
-	void addAfterCurrentAlbum() const;
-	void addAfterHighlightedSong() const;
+	void addToNewPlaylist();
+	void addToExistingPlaylist(const std::string &playlist);
+	void addAtTheEndOfPlaylist();
+	void addAtTheBeginningOfPlaylist();
+	void addAfterCurrentSong();
+	void addAfterCurrentAlbum();
+	void addAfterHighlightedSong();
 	void cancel();
 	void exitSuccessfully() const;
 	
+	const MPD::SongList &selectedItems();
+	
 	void setDimensions();
 	
 	size_t m_playlist_selector_width;
@@ -76,6 +78,7 @@ private:
 	Component m_position_selector;
 	
 	MPD::SongList m_selected_items;
+	bool m_server_side_adding;
 };
 
 extern SelectedItemsAdder *mySelectedItemsAdder;
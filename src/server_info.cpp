@@ -25,6 +25,7 @@
 #include "helpers.h"
 #include "server_info.h"
 #include "statusbar.h"
+#include "timers.h"
 #include "screen_switcher.h"
 
 using Global::MainHeight;
@@ -70,6 +71,7 @@ std::wstring ServerInfo::title()
 void ServerInfo::update()
 {
 	static timeval past = { 0, 0 };
+	Timers::wakeUpAt({ Global::Timer.tv_sec+1, 0 });
 	if (Global::Timer.tv_sec <= past.tv_sec)
 		return;
 	past = Global::Timer;
@@ -94,6 +96,12 @@ void ServerInfo::update()
 	w << NC::fmtBold << L"Songs in database: " << NC::fmtBoldEnd << stats.songs() << '\n';
 	w << '\n';
 	w << NC::fmtBold << L"Last DB update: " << NC::fmtBoldEnd << Timestamp(stats.dbUpdateTime()) << '\n';
+	if (Config.search_cache_size)
+	{
+		w << NC::fmtBold << L"Search cache: " << NC::fmtBoldEnd << Mpd.GetSearchCacheHits() << L" hits, "
+		  << Mpd.GetSearchCacheMisses() << L" misses, " << Mpd.GetSearchCacheUsage()/1024 << L" kB used\n";
+	}
+	w << NC::fmtBold << L"Status requests: " << NC::fmtBoldEnd << Mpd.GetStatusRequestsPerMinute() << L" per minute\n";
 	w << '\n';
 	w << NC::fmtBold << L"URL Handlers:" << NC::fmtBoldEnd;
 	for (auto it = itsURLHandlers.begin(); it != itsURLHandlers.end(); ++it)
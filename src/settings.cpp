@@ -26,6 +26,7 @@
 # include <sys/stat.h>
 #endif // WIN32
 #include <algorithm>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <string>
@@ -223,6 +224,9 @@ void Configuration::SetDefaults()
 	incremental_seeking = true;
 	now_playing_lyrics = false;
 	fetch_lyrics_in_background = false;
+	fetch_lyrics_concurrently = false;
+	fetch_artist_info_in_background = false;
+	http_compression = true;
 	local_browser_show_hidden_files = false;
 	search_in_db = true;
 	jump_to_now_playing_song_at_start = true;
@@ -242,13 +246,17 @@ void Configuration::SetDefaults()
 	new_design = false;
 	visualizer_use_wave = true;
 	visualizer_in_stereo = false;
+	visualizer_float_samples = false;
 	browser_sort_by_mtime = false;
 	media_library_sort_by_mtime = false;
 	tag_editor_extended_numeration = false;
 	media_library_display_date = true;
 	media_library_display_empty_tag = true;
+	media_library_prefetch = true;
+	media_library_recently_added_count = 100;
 	discard_colors_if_item_is_selected = true;
 	store_lyrics_in_song_dir = false;
+	lyrics_store = false;
 	ask_for_locked_screen_width_part = true;
 	progressbar_boldness = true;
 	set_window_title = true;
@@ -263,6 +271,16 @@ void Configuration::SetDefaults()
 	lines_scrolled = 2;
 	search_engine_default_search_mode = 0;
 	visualizer_sync_interval = 30;
+	visualizer_fps = 25;
+	visualizer_sample_rate = 44100;
+	visualizer_sample_bits = 16;
+	visualizer_channels = 0;
+	search_cache_size = 16;
+	random_items_recency_half_life = 0;
+	tag_cache_size = 20000;
+	lyrics_prefetch_count = 0;
+	lastfm_cache_ttl = 30;
+	lastfm_cache_size = 1000;
 	locked_screen_width_part = 0.5;
 	selected_item_prefix_length = 0;
 	selected_item_suffix_length = 0;
@@ -389,6 +407,11 @@ void Configuration::Read()
 				if (stringToInt(v))
 					mpd_connection_timeout = stringToInt(v);
 			}
+			else if (name == "mpd_search_cache_size")
+			{
+				if (!v.empty())
+					search_cache_size = stringToInt(v);
+			}
 			else if (name == "mpd_crossfade_time")
 			{
 				if (stringToInt(v) > 0)
@@ -507,6 +530,20 @@ void Configuration::Read()
 				if (!v.empty() && v != "en")
 					lastfm_preferred_language = v;
 			}
+			else if (name == "lastfm_cache_ttl")
+			{
+				if (!v.empty())
+					lastfm_cache_ttl = stringToInt(v);
+			}
+			else if (name == "lastfm_cache_size")
+			{
+				if (!v.empty())
+					lastfm_cache_size = stringToInt(v);
+			}
+			else if (name == "fetch_artist_info_in_background")
+			{
+				fetch_artist_info_in_background = v == "yes";
+			}
 			else if (name == "browser_playlist_prefix")
 			{
 				if (!v.empty())
@@ -716,6 +753,19 @@ void Configuration::Read()
 			{
 				fetch_lyrics_in_background = v == "yes";
 			}
+			else if (name == "fetch_lyrics_concurrently")
+			{
+				fetch_lyrics_concurrently = v == "yes";
+			}
+			else if (name == "lyrics_prefetch_count")
+			{
+				if (!v.empty())
+					lyrics_prefetch_count = stringToInt(v);
+			}
+			else if (name == "http_compression")
+			{
+				http_compression = v == "yes";
+			}
 			else if (name == "ncmpc_like_songs_adding")
 			{
 				ncmpc_like_songs_adding = v == "yes";
@@ -736,6 +786,11 @@ void Configuration::Read()
 			{
 				display_volume_level = v == "yes";
 			}
+			else if (name == "random_items_recency_half_life")
+			{
+				if (!v.empty())
+					random_items_recency_half_life = stringToInt(v);
+			}
 			else if (name == "display_bitrate")
 			{
 				display_bitrate = v == "yes";
@@ -776,6 +831,26 @@ void Configuration::Read()
 			{
 				visualizer_in_stereo = v == "yes";
 			}
+			else if (name == "visualizer_format")
+			{
+				// same syntax as format of mpd audio outputs, i.e. rate:bits:channels
+				unsigned rate, channels;
+				char bits[3];
+				if (!v.empty())
+				{
+					if (sscanf(v.c_str(), "%u:%2[^:]:%u", &rate, bits, &channels) == 3
+					&&  rate >= 8000 && rate <= 192000 && (channels == 1 || channels == 2)
+					&&  (!strcmp(bits, "16") || !strcmp(bits, "24") || !strcmp(bits, "32") || !strcmp(bits, "f")))
+					{
+						visualizer_sample_rate = rate;
+						visualizer_float_samples = bits[0] == 'f';
+						visualizer_sample_bits = visualizer_float_samples ? 32 : stringToInt(bits);
+						visualizer_channels = channels;
+					}
+					else
+						std::cerr << "Warning: visualizer_format \"" << v << "\" is not supported, discarding.\n";
+				}
+			}
 			else if (name == "mouse_support")
 			{
 				mouse_support = v == "yes";
@@ -792,6 +867,11 @@ void Configuration::Read()
 			{
 				tag_editor_extended_numeration = v == "yes";
 			}
+			else if (name == "tag_cache_size")
+			{
+				if (!v.empty())
+					tag_cache_size = stringToInt(v);
+			}
 			else if (name == "media_library_display_date")
 			{
 				media_library_display_date = v == "yes";
@@ -800,6 +880,15 @@ void Configuration::Read()
 			{
 				media_library_display_empty_tag = v == "yes";
 			}
+			else if (name == "media_library_prefetch")
+			{
+				media_library_prefetch = v == "yes";
+			}
+			else if (name == "media_library_recently_added_count")
+			{
+				if (!v.empty())
+					media_library_recently_added_count = stringToInt(v);
+			}
 			else if (name == "discard_colors_if_item_is_selected")
 			{
 				discard_colors_if_item_is_selected = v == "yes";
@@ -814,6 +903,10 @@ void Configuration::Read()
 				else
 					store_lyrics_in_song_dir = v == "yes";
 			}
+			else if (name == "lyrics_store")
+			{
+				lyrics_store = v == "yes";
+			}
 			else if (name == "enable_window_title")
 			{
 				set_window_title = v == "yes";
@@ -843,6 +936,12 @@ void Configuration::Read()
 				if (interval)
 					visualizer_sync_interval = interval;
 			}
+			else if (name == "visualizer_fps")
+			{
+				unsigned fps = stringToInt(v);
+				if (fps > 0 && fps <= 100)
+					visualizer_fps = fps;
+			}
 			else if (name == "sort_mode")
 			{
 				if (v == "mtime")
@@ -160,6 +160,9 @@ struct Configuration
 	bool incremental_seeking;
 	bool now_playing_lyrics;
 	bool fetch_lyrics_in_background;
+	bool fetch_lyrics_concurrently;
+	bool fetch_artist_info_in_background;
+	bool http_compression;
 	bool local_browser_show_hidden_files;
 	bool search_in_db;
 	bool jump_to_now_playing_song_at_start;
@@ -179,13 +182,17 @@ struct Configuration
 	bool new_design;
 	bool visualizer_use_wave;
 	bool visualizer_in_stereo;
+	bool visualizer_float_samples;
 	bool browser_sort_by_mtime;
 	bool media_library_sort_by_mtime;
 	bool tag_editor_extended_numeration;
 	bool media_library_display_date;
 	bool media_library_display_empty_tag;
+	bool media_library_prefetch;
+	unsigned media_library_recently_added_count;
 	bool discard_colors_if_item_is_selected;
 	bool store_lyrics_in_song_dir;
+	bool lyrics_store;
 	bool ask_for_locked_screen_width_part;
 	bool progressbar_boldness;
 	
@@ -201,6 +208,16 @@ struct Configuration
 	unsigned lines_scrolled;
 	unsigned search_engine_default_search_mode;
 	unsigned visualizer_sync_interval;
+	unsigned visualizer_fps;
+	unsigned visualizer_sample_rate;
+	unsigned visualizer_sample_bits;
+	unsigned visualizer_channels;
+	unsigned search_cache_size;
+	unsigned random_items_recency_half_life;
+	unsigned tag_cache_size;
+	unsigned lyrics_prefetch_count;
+	unsigned lastfm_cache_ttl;
+	unsigned lastfm_cache_size;
 	
 	double locked_screen_width_part;
 	
@@ -22,14 +22,10 @@
 #include "helpers.h"
 #include "song_info.h"
 #include "tag_editor.h"
+#include "tags.h"
 #include "title.h"
 #include "screen_switcher.h"
 
-#ifdef HAVE_TAGLIB_H
-# include "fileref.h"
-# include "tag.h"
-#endif // HAVE_TAGLIB_H
-
 using Global::MainHeight;
 using Global::MainStartY;
 
@@ -98,7 +94,8 @@ void SongInfo::PrepareSong(MPD::Song &s)
 	if (s.isFromDatabase())
 		path_to_file += Config.mpd_music_dir;
 	path_to_file += s.getURI();
-	TagLib::FileRef f(path_to_file.c_str());
+	Tags::FileInfo info;
+	bool has_info = Tags::read(path_to_file, info);
 #	endif // HAVE_TAGLIB_H
 	
 	w << NC::fmtBold << Config.color1 << L"Filename: " << NC::fmtBoldEnd << Config.color2 << s.getName() << '\n' << NC::clEnd;
@@ -107,11 +104,11 @@ void SongInfo::PrepareSong(MPD::Song &s)
 	w << L"\n\n" << NC::clEnd;
 	w << NC::fmtBold << L"Length: " << NC::fmtBoldEnd << Config.color2 << s.getLength() << '\n' << NC::clEnd;
 #	ifdef HAVE_TAGLIB_H
-	if (!f.isNull())
+	if (has_info)
 	{
-		w << NC::fmtBold << L"Bitrate: " << NC::fmtBoldEnd << Config.color2 << f.audioProperties()->bitrate() << L" kbps\n" << NC::clEnd;
-		w << NC::fmtBold << L"Sample rate: " << NC::fmtBoldEnd << Config.color2 << f.audioProperties()->sampleRate() << L" Hz\n" << NC::clEnd;
-		w << NC::fmtBold << L"Channels: " << NC::fmtBoldEnd << Config.color2 << (f.audioProperties()->channels() == 1 ? L"Mono" : L"Stereo") << '\n' << NC::clDefault;
+		w << NC::fmtBold << L"Bitrate: " << NC::fmtBoldEnd << Config.color2 << info.Bitrate << L" kbps\n" << NC::clEnd;
+		w << NC::fmtBold << L"Sample rate: " << NC::fmtBoldEnd << Config.color2 << info.SampleRate << L" Hz\n" << NC::clEnd;
+		w << NC::fmtBold << L"Channels: " << NC::fmtBoldEnd << Config.color2 << (info.Channels == 1 ? L"Mono" : L"Stereo") << '\n' << NC::clDefault;
 	}
 #	endif // HAVE_TAGLIB_H
 	w << NC::clDefault;
@@ -18,12 +18,15 @@
  *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
  ***************************************************************************/
 
+#include <algorithm>
 #include <sys/time.h>
 
 #include "browser.h"
 #include "charset.h"
+#include "directory_tree.h"
 #include "global.h"
 #include "helpers.h"
+#include "lastfm.h"
 #include "lyrics.h"
 #include "media_library.h"
 #include "outputs.h"
@@ -35,6 +38,7 @@
 #include "status.h"
 #include "statusbar.h"
 #include "tag_editor.h"
+#include "timers.h"
 #include "visualizer.h"
 #include "title.h"
 
@@ -50,6 +54,12 @@ namespace {//
 
 timeval past = { 0, 0 };
 
+// bitrate is polled more rarely while it doesn't change
+const unsigned MaxBitratePollInterval = 8;
+unsigned bitrate_poll_interval = 1;
+unsigned last_bitrate = 0;
+time_t last_status_time = 0;
+
 size_t playing_song_scroll_begin = 0;
 size_t first_line_scroll_begin = 0;
 size_t second_line_scroll_begin = 0;
@@ -62,6 +72,14 @@ char mpd_consume;
 char mpd_crossfade;
 char mpd_db_updating;
 
+bool isBitrateDisplayed()
+{
+	// it's shown either in the header or in the statusbar
+	if (!Config.display_bitrate)
+		return false;
+	return Config.new_design || (Config.statusbar_visibility && Statusbar::isUnlocked());
+}
+
 void drawTitle(const MPD::Song &np)
 {
 	assert(!np.empty());
@@ -79,27 +97,56 @@ void Status::trace()
 		{
 			past = Timer;
 		}
-		else if (Config.display_bitrate && Global::Timer.tv_sec > past.tv_sec && Mpd.isPlaying())
+		else if (Mpd.isPlaying() && isBitrateDisplayed()
+		&&       Timer.tv_sec >= Mpd.GetStatusTime()+bitrate_poll_interval)
 		{
 			// ncmpcpp doesn't fetch status constantly if mpd supports
 			// idle mode so current song's bitrate is never updated.
-			// we need to force ncmpcpp to fetch it.
+			// we need to force ncmpcpp to fetch it. status fetched
+			// for any other reason postpones it.
 			Mpd.OrderDataFetching();
-			past = Timer;
 		}
 		Mpd.UpdateStatus();
+		
+		if (Mpd.GetStatusTime() != last_status_time)
+		{
+			last_status_time = Mpd.GetStatusTime();
+			if (Mpd.GetBitrate() == last_bitrate)
+				bitrate_poll_interval = std::min(bitrate_poll_interval*2, MaxBitratePollInterval);
+			else
+				bitrate_poll_interval = 1;
+			last_bitrate = Mpd.GetBitrate();
+		}
 	}
 	
+	// elapsed time is counted with a resolution of a second and without
+	// idle mode status has to be polled, so wake up when the next one begins
+	if (Mpd.Connected() && (!Mpd.SupportsIdle() || Mpd.isPlaying()))
+		Timers::wakeUpAt({ Timer.tv_sec+1, 0 });
+	
 	applyToVisibleWindows(&BaseScreen::update);
 	
+#	ifdef ENABLE_VISUALIZER
+	myVisualizer->Sync();
+#	endif // ENABLE_VISUALIZER
+	
+#	ifdef HAVE_CURL_CURL_H
+	Lyrics::Prefetch();
+#	endif // HAVE_CURL_CURL_H
+	
 	if (isVisible(myPlaylist)
-	&&  Timer.tv_sec == myPlaylist->Timer().tv_sec+Config.playlist_disable_highlight_delay
-	&&  Timer.tv_usec > myPlaylist->Timer().tv_usec
 	&&  myPlaylist->main().isHighlighted()
 	&&  Config.playlist_disable_highlight_delay)
 	{
-		myPlaylist->main().setHighlighting(false);
-		myPlaylist->main().refresh();
+		timeval deadline = myPlaylist->Timer();
+		deadline.tv_sec += Config.playlist_disable_highlight_delay;
+		if (!timercmp(&Timer, &deadline, <))
+		{
+			myPlaylist->main().setHighlighting(false);
+			myPlaylist->main().refresh();
+		}
+		else
+			Timers::wakeUpAt(deadline);
 	}
 	
 	Statusbar::tryRedraw();
@@ -179,6 +226,8 @@ void Status::Changes::storedPlaylists()
 {
 	myPlaylistEditor->requestPlaylistsUpdate();
 	myPlaylistEditor->requestContentsUpdate();
+	// stored playlists are listed in root directory
+	DatabaseTree.clear("/");
 	if (myBrowser->CurrentDir() == "/")
 	{
 		myBrowser->GetDirectory("/");
@@ -189,6 +238,7 @@ void Status::Changes::storedPlaylists()
 
 void Status::Changes::database()
 {
+	DatabaseTree.clear();
 	if (isVisible(myBrowser))
 		myBrowser->GetDirectory(myBrowser->CurrentDir());
 	else
@@ -200,6 +250,7 @@ void Status::Changes::database()
 		myLibrary->Albums.clear();
 	else
 		myLibrary->Tags.clear();
+	myLibrary->clearPrefetched();
 }
 
 void Status::Changes::playerState()
@@ -249,11 +300,6 @@ void Status::Changes::playerState()
 		}
 	}
 	
-#	ifdef ENABLE_VISUALIZER
-	if (myScreen == myVisualizer)
-		wFooter->setTimeout(state == MPD::psPlay ? Visualizer::WindowTimeout : 500);
-#	endif // ENABLE_VISUALIZER
-	
 	if (Config.new_design)
 	{
 		*wHeader << NC::XY(0, 1) << NC::fmtBold << player_state << NC::fmtBoldEnd;
@@ -284,6 +330,8 @@ void Status::Changes::songID()
 #		ifdef HAVE_CURL_CURL_H
 		if (Config.fetch_lyrics_in_background)
 			Lyrics::DownloadInBackground(myPlaylist->nowPlayingSong());
+		if (Config.fetch_artist_info_in_background)
+			Lastfm::Prefetch(myPlaylist->nowPlayingSong().getArtist());
 #		endif // HAVE_CURL_CURL_H
 		
 		drawTitle(myPlaylist->nowPlayingSong());
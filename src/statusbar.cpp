@@ -18,10 +18,15 @@
  *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
  ***************************************************************************/
 
+#include <poll.h>
+#include <unistd.h>
+#include <ctime>
+
 #include "global.h"
 #include "settings.h"
 #include "status.h"
 #include "statusbar.h"
+#include "timers.h"
 
 using Global::wFooter;
 
@@ -157,6 +162,8 @@ void Statusbar::tryRedraw()
 			wFooter->refresh();
 		}
 	}
+	else if (statusbarLockDelay > 0)
+		Timers::wakeUpAt({ statusbarLockTime.tv_sec+statusbarLockDelay, 0 });
 }
 
 NC::Window &Statusbar::put()
@@ -181,6 +188,48 @@ void Statusbar::msg(int time, const char *format, ...)
 	va_end(list);
 }
 
+void Statusbar::waitForThreads(pthread_mutex_t &lock, pthread_cond_t &cond,
+                               const size_t &finished, size_t threads, unsigned interval,
+                               const std::function<std::string()> &progress, bool &cancelled)
+{
+	pthread_mutex_lock(&lock);
+	while (finished < threads)
+	{
+		std::string message = progress();
+		pthread_mutex_unlock(&lock);
+		put() << message << " (press any key to cancel)";
+		wFooter->refresh();
+		bool key_pressed = false;
+#		if !defined(USE_PDCURSES)
+		pollfd stdin_fd = { STDIN_FILENO, POLLIN, 0 };
+		if (poll(&stdin_fd, 1, 0) > 0)
+		{
+			// discard the key so that it doesn't trigger any action. it's
+			// read directly, as readKey() would also handle mpd events.
+			int old_timeout = wFooter->getTimeout();
+			wFooter->setTimeout(0);
+			wgetch(wFooter->raw());
+			wFooter->setTimeout(old_timeout);
+			key_pressed = true;
+		}
+#		endif // !USE_PDCURSES
+		pthread_mutex_lock(&lock);
+		if (key_pressed)
+			cancelled = true;
+		timespec timeout;
+		clock_gettime(CLOCK_REALTIME, &timeout);
+		timeout.tv_sec += interval/1000;
+		timeout.tv_nsec += (interval%1000)*1000*1000;
+		if (timeout.tv_nsec >= 1000*1000*1000)
+		{
+			timeout.tv_nsec -= 1000*1000*1000;
+			++timeout.tv_sec;
+		}
+		pthread_cond_timedwait(&cond, &lock, &timeout);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
 void Statusbar::Helpers::mpd()
 {
 	Mpd.OrderDataFetching();
@@ -21,6 +21,10 @@
 #ifndef _STATUSBAR_H
 #define _STATUSBAR_H
 
+#include <pthread.h>
+#include <functional>
+#include <string>
+
 #include "gcc.h"
 #include "interfaces.h"
 #include "window.h"
@@ -65,6 +69,15 @@ void msg(const char *format, ...) GNUC_PRINTF(1, 2);
 /// displays message in statusbar for given period of time
 void msg(int time, const char *format, ...) GNUC_PRINTF(2, 3);
 
+/// shows progress of work done by other threads until all of them finish,
+/// i.e. finished becomes equal to threads. progress is called with lock held
+/// every interval milliseconds (or sooner if cond is signalled) and its result
+/// is displayed along with a note that any key cancels the work, in which case
+/// cancelled is set (also with lock held). lock must not be held by caller.
+void waitForThreads(pthread_mutex_t &lock, pthread_cond_t &cond,
+                    const size_t &finished, size_t threads, unsigned interval,
+                    const std::function<std::string()> &progress, bool &cancelled);
+
 namespace Helpers {//
 
 /// called when statusbar window detects incoming idle notification
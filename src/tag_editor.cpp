@@ -24,10 +24,13 @@
 
 #include <algorithm>
 #include <fstream>
+#include <pthread.h>
 #include <sstream>
+#include <unistd.h>
 
 #include "browser.h"
 #include "charset.h"
+#include "directory_tree.h"
 #include "display.h"
 #include "global.h"
 #include "helpers.h"
@@ -38,6 +41,7 @@
 #include "title.h"
 #include "tags.h"
 #include "screen_switcher.h"
+#include "workers.h"
 
 using namespace std::placeholders;
 
@@ -67,6 +71,8 @@ std::list<std::string> Patterns;
 std::string PatternsFile = "patterns.list";
 
 bool isAnyModified(const NC::Menu<MPD::MutableSong> &m);
+const MPD::MutableSong *writeTags(const std::vector<MPD::MutableSong *> &songs,
+                                  std::vector<MPD::MutableSong *> &written, bool &cancelled);
 
 std::string CapitalizeFirstLetters(const std::string &s);
 void CapitalizeFirstLetters(MPD::MutableSong &s);
@@ -77,7 +83,71 @@ void SavePatternList();
 
 MPD::MutableSong::SetFunction IntoSetFunction(char c);
 std::string GenerateFilename(const MPD::MutableSong &s, const std::string &pattern);
-std::string ParseFilename(MPD::MutableSong &s, std::string mask, bool preview);
+
+// pattern for getting tags from filenames, split into
+// tags and separators once and then used for all songs
+class FilenameParser
+{
+public:
+	FilenameParser(std::string mask);
+	
+	/// sets tags of the song according to its filename
+	/// @return false if filename doesn't match the pattern
+	bool apply(MPD::MutableSong &s) const;
+	
+	/// @return description of tags that would be set
+	std::string preview(const MPD::MutableSong &s) const;
+	
+private:
+	bool parse(const std::string &filename, std::vector<std::string> &values) const;
+	
+	std::vector<char> m_tags;
+	std::vector<std::string> m_separators;
+};
+
+// computes preview of parsing/renaming in separate thread, so that the
+// interface doesn't freeze with big selections. results are taken in
+// chunks and appended to the preview window as they come.
+class FilenamePreview
+{
+public:
+	struct Entry
+	{
+		std::string Filename;
+		std::string Result;
+	};
+	
+	FilenamePreview();
+	~FilenamePreview();
+	
+	void start(const std::vector<MPD::MutableSong *> &songs, const std::string &pattern, bool get_tags);
+	void stop();
+	
+	bool isRunning() const { return m_running; }
+	
+	/// moves computed entries to given vector
+	/// @return true if all entries were computed
+	bool take(std::vector<Entry> &entries);
+	
+private:
+	static void *worker(void *data);
+	
+	pthread_t m_thread;
+	pthread_mutex_t m_lock;
+	bool m_running;
+	bool m_threaded;
+	bool m_cancelled;
+	bool m_finished;
+	
+	bool m_get_tags;
+	std::string m_pattern;
+	std::vector<MPD::MutableSong> m_songs;
+	std::vector<Entry> m_entries;
+};
+
+FilenamePreview Preview;
+bool PreviewGetsTags;
+void showPreview(NC::Scrollpad &w, const FilenamePreview::Entry &e);
 
 std::string SongToString(const MPD::MutableSong &s);
 bool DirEntryMatcher(const Regex &rx, const std::pair<std::string, std::string> &dir, bool filter);
@@ -221,14 +291,29 @@ void TagEditor::refresh()
 
 void TagEditor::update()
 {
+	if (Preview.isRunning())
+	{
+		std::vector<FilenamePreview::Entry> entries;
+		bool finished = Preview.take(entries);
+		if (!entries.empty())
+		{
+			for (auto it = entries.begin(); it != entries.end(); ++it)
+				showPreview(*FParserPreview, *it);
+			FParserPreview->flush();
+			if (w == FParser && FParserHelper == FParserPreview)
+				FParserPreview->refresh();
+		}
+		if (finished)
+			Preview.stop();
+	}
+	
 	if (Dirs->reallyEmpty())
 	{
 		Dirs->Window::clear();
 		Tags->clear();
 		
 		int highlightme = -1;
-		auto dirs = Mpd.GetDirectories(itsBrowsedDir);
-		std::sort(dirs.begin(), dirs.end(), LocaleBasedSorting(std::locale(), Config.ignore_leading_the));
+		const MPD::StringList &dirs = DatabaseTree.directories(itsBrowsedDir);
 		if (itsBrowsedDir != "/")
 		{
 			size_t slash = itsBrowsedDir.rfind("/");
@@ -279,8 +364,7 @@ void TagEditor::enterPressed()
 	
 	if (w == Dirs)
 	{
-		auto dirs = Mpd.GetDirectories(Dirs->current().value().second);
-		if (!dirs.empty())
+		if (!DatabaseTree.directories(Dirs->current().value().second).empty())
 		{
 			itsHighlightedDir = itsBrowsedDir;
 			itsBrowsedDir = Dirs->current().value().second;
@@ -341,7 +425,6 @@ void TagEditor::enterPressed()
 		
 		FParser->setTitle(choice == 0 ? "Get tags from filename" : "Rename files");
 		w = FParser;
-		FParserUsePreview = 1;
 		FParserHelper = FParserLegend;
 		FParserHelper->display();
 	}
@@ -350,9 +433,6 @@ void TagEditor::enterPressed()
 		bool quit = 0;
 		size_t pos = FParser->choice();
 		
-		if (pos == 4) // save
-			FParserUsePreview = 0;
-		
 		if (pos == 0) // change pattern
 		{
 			Statusbar::lock();
@@ -366,62 +446,53 @@ void TagEditor::enterPressed()
 				FParser->at(0).value() += Config.pattern;
 			}
 		}
-		else if (pos == 1 || pos == 4) // preview or proceed
+		else if (pos == 1) // preview
 		{
-			bool success = 1;
-			Statusbar::msg("Parsing...");
-			FParserPreview->clear();
-			for (auto it = EditedSongs.begin(); it != EditedSongs.end(); ++it)
+			showFilenamePreview(FParserDialog->choice() == 0);
+		}
+		else if (pos == 4) // proceed
+		{
+			Preview.stop();
+			bool success = true;
+			if (FParserDialog->choice() == 0) // get tags from filename
+			{
+				FilenameParser parser(Config.pattern);
+				for (auto it = EditedSongs.begin(); it != EditedSongs.end(); ++it)
+					parser.apply(**it);
+			}
+			else // rename files
 			{
-				MPD::MutableSong &s = **it;
-				if (FParserDialog->choice() == 0) // get tags from filename
+				std::string pattern = "{" + Config.pattern + "}";
+				std::vector<std::string> new_names;
+				new_names.reserve(EditedSongs.size());
+				for (auto it = EditedSongs.begin(); it != EditedSongs.end(); ++it)
 				{
-					if (FParserUsePreview)
+					new_names.push_back(GenerateFilename(**it, pattern));
+					if (new_names.back().empty())
 					{
-						*FParserPreview << NC::fmtBold << s.getName() << L":\n" << NC::fmtBoldEnd;
-						*FParserPreview << ParseFilename(s, Config.pattern, FParserUsePreview) << '\n';
+						Statusbar::msg("File \"%s\" would have an empty name", (*it)->getName().c_str());
+						success = false;
+						break;
 					}
-					else
-						ParseFilename(s, Config.pattern, FParserUsePreview);
 				}
-				else // rename files
+				if (success)
 				{
-					std::string file = s.getName();
-					size_t last_dot = file.rfind(".");
-					std::string extension = file.substr(last_dot);
-					std::string new_file = GenerateFilename(s, "{" + Config.pattern + "}");
-					if (new_file.empty() && !FParserUsePreview)
+					for (size_t i = 0; i < EditedSongs.size(); ++i)
 					{
-						Statusbar::msg("File \"%s\" would have an empty name", s.getName().c_str());
-						FParserUsePreview = 1;
-						success = 0;
+						const std::string &file = EditedSongs[i]->getName();
+						EditedSongs[i]->setNewURI(new_names[i] + file.substr(file.rfind(".")));
 					}
-					if (!FParserUsePreview)
-						s.setNewURI(new_file + extension);
-					*FParserPreview << file << Config.color2 << L" -> " << NC::clEnd;
-					if (new_file.empty())
-						*FParserPreview << Config.empty_tags_color << Config.empty_tag << NC::clEnd;
-					else
-						*FParserPreview << new_file << extension;
-					*FParserPreview << '\n' << '\n';
-					if (!success)
-						break;
 				}
+				else
+					showFilenamePreview(false);
 			}
-			if (FParserUsePreview)
-			{
-				FParserHelper = FParserPreview;
-				FParserHelper->flush();
-				FParserHelper->display();
-			}
-			else if (success)
+			if (success)
 			{
 				Patterns.remove(Config.pattern);
 				Patterns.insert(Patterns.begin(), Config.pattern);
+				Statusbar::msg("Operation finished");
 				quit = 1;
 			}
-			if (pos != 4 || success)
-				Statusbar::msg("Operation finished");
 		}
 		else if (pos == 2) // show legend
 		{
@@ -440,6 +511,7 @@ void TagEditor::enterPressed()
 		
 		if (quit)
 		{
+			Preview.stop();
 			SavePatternList();
 			w = TagTypes;
 			refresh();
@@ -556,20 +628,27 @@ void TagEditor::enterPressed()
 		}
 		else if (id == 20) // save
 		{
-			bool success = 1;
-			Statusbar::msg("Writing changes...");
-			for (auto it = EditedSongs.begin(); it != EditedSongs.end(); ++it)
+			std::vector<MPD::MutableSong *> written;
+			bool cancelled;
+			const MPD::MutableSong *failed = writeTags(EditedSongs, written, cancelled);
+			if (!written.empty())
 			{
-				Statusbar::msg("Writing tags in \"%s\"...", (*it)->getName().c_str());
-				if (!Tags::write(**it))
-				{
-					const char msg[] = "Error while writing tags in \"%ls\"";
-					Statusbar::msg(msg, wideShorten(ToWString((*it)->getURI()), COLS-const_strlen(msg)).c_str());
-					success = 0;
-					break;
-				}
+				// a single update of the shared directory is much
+				// cheaper for mpd than updating every file separately
+				std::string directory = written.front()->getDirectory();
+				for (auto it = written.begin()+1; it != written.end() && directory != "/"; ++it)
+					directory = getSharedDirectory(directory, (*it)->getDirectory());
+				Mpd.UpdateDirectory(directory);
 			}
-			if (success)
+			if (failed)
+			{
+				const char msg[] = "Error while writing tags in \"%ls\"";
+				Statusbar::msg(msg, wideShorten(ToWString(failed->getURI()), COLS-const_strlen(msg)).c_str());
+				Tags->clear();
+			}
+			else if (cancelled)
+				Statusbar::msg("Writing cancelled, tags updated in %zu file(s)", written.size());
+			else
 			{
 				Statusbar::msg("Tags updated");
 				TagTypes->setHighlightColor(Config.main_highlight_color);
@@ -577,14 +656,21 @@ void TagEditor::enterPressed()
 				w->refresh();
 				w = Dirs;
 				Dirs->setHighlightColor(Config.active_column_color);
-				Mpd.UpdateDirectory(getSharedDirectory(Tags->beginV(), Tags->endV()));
 			}
-			else
-				Tags->clear();
 		}
 	}
 }
 
+void TagEditor::showFilenamePreview(bool get_tags)
+{
+	PreviewGetsTags = get_tags;
+	Preview.start(EditedSongs, Config.pattern, get_tags);
+	FParserPreview->clear();
+	FParserHelper = FParserPreview;
+	FParserHelper->flush();
+	FParserHelper->display();
+}
+
 void TagEditor::spacePressed()
 {
 	if (w == Tags && !Tags->empty())
@@ -1004,6 +1090,94 @@ bool isAnyModified(const NC::Menu<MPD::MutableSong> &m)
 	return false;
 }
 
+struct TagWriter
+{
+	TagWriter(const std::vector<MPD::MutableSong *> &songs)
+	: Songs(songs), Next(0), Failed(0), Cancelled(false), Finished(0)
+	{
+		pthread_mutex_init(&Lock, 0);
+		pthread_cond_init(&Progress, 0);
+	}
+	~TagWriter()
+	{
+		pthread_cond_destroy(&Progress);
+		pthread_mutex_destroy(&Lock);
+	}
+	
+	static void *worker(void *data);
+	
+	pthread_mutex_t Lock;
+	pthread_cond_t Progress;
+	
+	const std::vector<MPD::MutableSong *> &Songs;
+	size_t Next;
+	std::vector<MPD::MutableSong *> Written;
+	MPD::MutableSong *Failed;
+	bool Cancelled;
+	size_t Finished;
+};
+
+void *TagWriter::worker(void *data)
+{
+	TagWriter &tw = *static_cast<TagWriter *>(data);
+	pthread_mutex_lock(&tw.Lock);
+	while (tw.Next < tw.Songs.size() && !tw.Failed && !tw.Cancelled)
+	{
+		MPD::MutableSong *s = tw.Songs[tw.Next++];
+		pthread_mutex_unlock(&tw.Lock);
+		bool success = Tags::write(*s);
+		pthread_mutex_lock(&tw.Lock);
+		if (success)
+			tw.Written.push_back(s);
+		else if (!tw.Failed)
+			tw.Failed = s;
+		pthread_cond_signal(&tw.Progress);
+	}
+	++tw.Finished;
+	pthread_cond_signal(&tw.Progress);
+	pthread_mutex_unlock(&tw.Lock);
+	return 0;
+}
+
+// writes tags of modified songs using a few threads, since most of the time
+// is spent waiting for the disk. any key pressed meanwhile cancels writing of
+// the remaining files (the ones that are being written are finished anyway).
+const MPD::MutableSong *writeTags(const std::vector<MPD::MutableSong *> &songs,
+                                  std::vector<MPD::MutableSong *> &written, bool &cancelled)
+{
+	std::vector<MPD::MutableSong *> modified;
+	std::copy_if(songs.begin(), songs.end(), std::back_inserter(modified),
+		std::bind(&MPD::MutableSong::isModified, _1));
+	TagWriter tw(modified);
+	
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t threads_count = std::min<size_t>(std::min(std::max(cores, 2L), 8L), modified.size());
+	std::vector<pthread_t> threads;
+	for (size_t i = 0; i < threads_count; ++i)
+	{
+		pthread_t t;
+		if (pthread_create(&t, 0, TagWriter::worker, &tw) == 0)
+			threads.push_back(t);
+	}
+	
+	if (threads.empty())
+		TagWriter::worker(&tw);
+	else
+	{
+		Statusbar::waitForThreads(tw.Lock, tw.Progress, tw.Finished, threads.size(), 100,
+			[&tw, &modified]() {
+				return "Writing tags... " + intTo<std::string>::apply(tw.Written.size())
+				     + "/" + intTo<std::string>::apply(modified.size());
+			}, tw.Cancelled);
+		for (auto t = threads.begin(); t != threads.end(); ++t)
+			pthread_join(*t, 0);
+	}
+	
+	written.swap(tw.Written);
+	cancelled = tw.Cancelled;
+	return tw.Failed;
+}
+
 std::string CapitalizeFirstLetters(const std::string &s)
 {
 	std::wstring ws = ToWString(s);
@@ -1102,59 +1276,182 @@ std::string GenerateFilename(const MPD::MutableSong &s, const std::string &patte
 	return result;
 }
 
-std::string ParseFilename(MPD::MutableSong &s, std::string mask, bool preview)
+FilenameParser::FilenameParser(std::string mask)
 {
-	std::ostringstream result;
-	std::vector<std::string> separators;
-	std::vector< std::pair<char, std::string> > tags;
-	std::string file = s.getName().substr(0, s.getName().rfind("."));
-	
-	for (size_t i = mask.find("%"); i != std::string::npos; i = mask.find("%"))
+	for (size_t i = mask.find("%"); i != std::string::npos && i+1 < mask.length(); i = mask.find("%"))
 	{
-		tags.push_back(std::make_pair(mask.at(i+1), ""));
+		m_tags.push_back(mask[i+1]);
 		mask = mask.substr(i+2);
 		i = mask.find("%");
 		if (!mask.empty())
-			separators.push_back(mask.substr(0, i));
+			m_separators.push_back(mask.substr(0, i));
 	}
+}
+
+bool FilenameParser::parse(const std::string &filename, std::vector<std::string> &values) const
+{
+	values.assign(m_tags.size(), "");
+	size_t begin = 0, end = filename.rfind(".");
+	if (end == std::string::npos)
+		end = filename.length();
 	size_t i = 0;
-	for (auto it = separators.begin(); it != separators.end(); ++it, ++i)
+	for (auto it = m_separators.begin(); it != m_separators.end(); ++it, ++i)
 	{
-		size_t j = file.find(*it);
-		tags.at(i).second = file.substr(0, j);
-		if (j+it->length() > file.length())
-			goto PARSE_FAILED;
-		file = file.substr(j+it->length());
+		size_t j = filename.find(*it, begin);
+		if (j == std::string::npos || j+it->length() > end)
+			return false;
+		values[i] = filename.substr(begin, j-begin);
+		begin = j+it->length();
 	}
-	if (!file.empty())
+	if (begin < end)
 	{
-		if (i >= tags.size())
-			goto PARSE_FAILED;
-		tags.at(i).second = file;
+		if (i >= values.size())
+			return false;
+		values[i] = filename.substr(begin, end-begin);
 	}
-	
-	if (0) // tss...
+	for (auto it = values.begin(); it != values.end(); ++it)
+		std::replace(it->begin(), it->end(), '_', ' ');
+	return true;
+}
+
+bool FilenameParser::apply(MPD::MutableSong &s) const
+{
+	std::vector<std::string> values;
+	if (!parse(s.getName(), values))
+		return false;
+	for (size_t i = 0; i < m_tags.size(); ++i)
 	{
-		PARSE_FAILED:
+		MPD::MutableSong::SetFunction set = IntoSetFunction(m_tags[i]);
+		if (set)
+			s.setTags(set, values[i], Config.tags_separator);
+	}
+	return true;
+}
+
+std::string FilenameParser::preview(const MPD::MutableSong &s) const
+{
+	std::vector<std::string> values;
+	if (!parse(s.getName(), values))
 		return "Error while parsing filename!\n";
+	std::string result;
+	for (size_t i = 0; i < m_tags.size(); ++i)
+	{
+		result += '%';
+		result += m_tags[i];
+		result += ": ";
+		result += values[i];
+		result += '\n';
 	}
-	
-	for (auto it = tags.begin(); it != tags.end(); ++it)
+	return result;
+}
+
+/**********************************************************************/
+
+FilenamePreview::FilenamePreview() : m_running(false), m_threaded(false), m_cancelled(false), m_finished(false)
+{
+	pthread_mutex_init(&m_lock, 0);
+}
+
+FilenamePreview::~FilenamePreview()
+{
+	stop();
+	pthread_mutex_destroy(&m_lock);
+}
+
+void FilenamePreview::start(const std::vector<MPD::MutableSong *> &songs, const std::string &pattern, bool get_tags)
+{
+	stop();
+	// worker gets its own copies, so that songs can be safely
+	// modified while preview is being computed
+	m_songs.clear();
+	m_songs.reserve(songs.size());
+	for (auto it = songs.begin(); it != songs.end(); ++it)
+		m_songs.push_back(**it);
+	m_entries.clear();
+	m_pattern = pattern;
+	m_get_tags = get_tags;
+	m_cancelled = false;
+	m_finished = false;
+	m_running = true;
+	m_threaded = pthread_create(&m_thread, 0, worker, this) == 0;
+	if (!m_threaded)
+		worker(this);
+}
+
+void FilenamePreview::stop()
+{
+	if (!m_running)
+		return;
+	pthread_mutex_lock(&m_lock);
+	m_cancelled = true;
+	pthread_mutex_unlock(&m_lock);
+	if (m_threaded)
+		pthread_join(m_thread, 0);
+	m_running = false;
+}
+
+bool FilenamePreview::take(std::vector<Entry> &entries)
+{
+	pthread_mutex_lock(&m_lock);
+	entries.swap(m_entries);
+	bool finished = m_finished;
+	pthread_mutex_unlock(&m_lock);
+	return finished;
+}
+
+void *FilenamePreview::worker(void *data)
+{
+	FilenamePreview &p = *static_cast<FilenamePreview *>(data);
+	FilenameParser parser(p.m_pattern);
+	std::string pattern = "{" + p.m_pattern + "}";
+	Entry e;
+	for (auto it = p.m_songs.begin(); it != p.m_songs.end(); ++it)
 	{
-		for (std::string::iterator j = it->second.begin(); j != it->second.end(); ++j)
-			if (*j == '_')
-				*j = ' ';
-			
-			if (!preview)
-			{
-				MPD::MutableSong::SetFunction set = IntoSetFunction(it->first);
-				if (set)
-					s.setTags(set, it->second, Config.tags_separator);
-			}
-			else
-				result << "%" << it->first << ": " << it->second << "\n";
+		e.Filename = it->getName();
+		if (p.m_get_tags)
+			e.Result = parser.preview(*it);
+		else
+		{
+			e.Result = GenerateFilename(*it, pattern);
+			if (!e.Result.empty())
+				e.Result += e.Filename.substr(e.Filename.rfind("."));
+		}
+		pthread_mutex_lock(&p.m_lock);
+		bool cancelled = p.m_cancelled;
+		// main loop is woken up only when the first entry
+		// since they were taken for the last time arrives
+		bool first = p.m_entries.empty();
+		if (!cancelled)
+			p.m_entries.push_back(std::move(e));
+		pthread_mutex_unlock(&p.m_lock);
+		if (cancelled)
+			break;
+		if (first)
+			Workers::post([]() { });
+	}
+	pthread_mutex_lock(&p.m_lock);
+	p.m_finished = true;
+	pthread_mutex_unlock(&p.m_lock);
+	Workers::post([]() { });
+	return 0;
+}
+
+void showPreview(NC::Scrollpad &w, const FilenamePreview::Entry &e)
+{
+	if (PreviewGetsTags)
+	{
+		w << NC::fmtBold << e.Filename << L":\n" << NC::fmtBoldEnd;
+		w << e.Result << '\n';
+	}
+	else
+	{
+		w << e.Filename << Config.color2 << L" -> " << NC::clEnd;
+		if (e.Result.empty())
+			w << Config.empty_tags_color << Config.empty_tag << NC::clEnd;
+		else
+			w << e.Result;
+		w << '\n' << '\n';
 	}
-	return result.str();
 }
 
 std::string SongToString(const MPD::MutableSong &s)
@@ -90,6 +90,7 @@ protected:
 	
 private:
 	void SetDimensions(size_t, size_t);
+	void showFilenamePreview(bool get_tags);
 	
 	std::vector<MPD::MutableSong *> EditedSongs;
 	NC::Menu<std::string> *FParserDialog;
@@ -97,7 +98,6 @@ private:
 	NC::Scrollpad *FParserHelper;
 	NC::Scrollpad *FParserLegend;
 	NC::Scrollpad *FParserPreview;
-	bool FParserUsePreview;
 	
 	std::string itsBrowsedDir;
 	std::string itsHighlightedDir;
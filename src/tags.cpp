@@ -33,6 +33,13 @@
 #include <textidentificationframe.h>
 #include <xiphcomment.h>
 
+#include <cstdlib>
+#include <fstream>
+#include <list>
+#include <map>
+#include <pthread.h>
+#include <sys/stat.h>
+
 #include "global.h"
 #include "settings.h"
 #include "utility/numeric_conversions.h"
@@ -49,62 +56,62 @@ TagLib::StringList tagList(const MPD::MutableSong &s, MPD::Song::GetFunction f)
 	return result;
 }
 
-void readCommonTags(MPD::MutableSong &s, TagLib::Tag *tag)
+void readCommonTags(Tags::FileInfo &info, TagLib::Tag *tag)
 {
-	s.setTitle(tag->title().to8Bit(true));
-	s.setArtist(tag->artist().to8Bit(true));
-	s.setAlbum(tag->album().to8Bit(true));
-	s.setDate(intTo<std::string>::apply(tag->year()));
-	s.setTrack(intTo<std::string>::apply(tag->track()));
-	s.setGenre(tag->genre().to8Bit(true));
-	s.setComment(tag->comment().to8Bit(true));
+	info.set(Tags::Title, tag->title().to8Bit(true), 0);
+	info.set(Tags::Artist, tag->artist().to8Bit(true), 0);
+	info.set(Tags::Album, tag->album().to8Bit(true), 0);
+	info.set(Tags::Date, intTo<std::string>::apply(tag->year()), 0);
+	info.set(Tags::Track, intTo<std::string>::apply(tag->track()), 0);
+	info.set(Tags::Genre, tag->genre().to8Bit(true), 0);
+	info.set(Tags::Comment, tag->comment().to8Bit(true), 0);
 }
 
-void readID3v1Tags(MPD::MutableSong &s, TagLib::ID3v1::Tag *tag)
+void readID3v1Tags(Tags::FileInfo &info, TagLib::ID3v1::Tag *tag)
 {
-	readCommonTags(s, tag);
+	readCommonTags(info, tag);
 }
 
-void readID3v2Tags(MPD::MutableSong &s, TagLib::ID3v2::Tag *tag)
+void readID3v2Tags(Tags::FileInfo &info, TagLib::ID3v2::Tag *tag)
 {
-	auto readFrame = [&s](const TagLib::ID3v2::FrameList &list, MPD::MutableSong::SetFunction f) {
+	auto readFrame = [&info](const TagLib::ID3v2::FrameList &list, Tags::Type type) {
 		unsigned idx = 0;
 		for (auto it = list.begin(); it != list.end(); ++it, ++idx)
-			(s.*f)((*it)->toString().to8Bit(true), idx);
+			info.set(type, (*it)->toString().to8Bit(true), idx);
 	};
 	auto &frames = tag->frameListMap();
-	readFrame(frames["TIT2"], &MPD::MutableSong::setTitle);
-	readFrame(frames["TPE1"], &MPD::MutableSong::setArtist);
-	readFrame(frames["TPE2"], &MPD::MutableSong::setAlbumArtist);
-	readFrame(frames["TALB"], &MPD::MutableSong::setAlbum);
-	readFrame(frames["TDRC"], &MPD::MutableSong::setDate);
-	readFrame(frames["TRCK"], &MPD::MutableSong::setTrack);
-	readFrame(frames["TCON"], &MPD::MutableSong::setGenre);
-	readFrame(frames["TCOM"], &MPD::MutableSong::setComposer);
-	readFrame(frames["TPE3"], &MPD::MutableSong::setPerformer);
-	readFrame(frames["TPOS"], &MPD::MutableSong::setDisc);
-	readFrame(frames["COMM"], &MPD::MutableSong::setComment);
+	readFrame(frames["TIT2"], Tags::Title);
+	readFrame(frames["TPE1"], Tags::Artist);
+	readFrame(frames["TPE2"], Tags::AlbumArtist);
+	readFrame(frames["TALB"], Tags::Album);
+	readFrame(frames["TDRC"], Tags::Date);
+	readFrame(frames["TRCK"], Tags::Track);
+	readFrame(frames["TCON"], Tags::Genre);
+	readFrame(frames["TCOM"], Tags::Composer);
+	readFrame(frames["TPE3"], Tags::Performer);
+	readFrame(frames["TPOS"], Tags::Disc);
+	readFrame(frames["COMM"], Tags::Comment);
 }
 
-void readXiphComments(MPD::MutableSong &s, TagLib::Ogg::XiphComment *tag)
+void readXiphComments(Tags::FileInfo &info, TagLib::Ogg::XiphComment *tag)
 {
-	auto readField = [&s](const TagLib::StringList &list, MPD::MutableSong::SetFunction f) {
+	auto readField = [&info](const TagLib::StringList &list, Tags::Type type) {
 		unsigned idx = 0;
 		for (auto it = list.begin(); it != list.end(); ++it)
-			(s.*f)(it->to8Bit(true), idx);
+			info.set(type, it->to8Bit(true), idx);
 	};
 	auto &fields = tag->fieldListMap();
-	readField(fields["TITLE"], &MPD::MutableSong::setTitle);
-	readField(fields["ARTIST"], &MPD::MutableSong::setArtist);
-	readField(fields["ALBUMARTIST"], &MPD::MutableSong::setAlbumArtist);
-	readField(fields["ALBUM"], &MPD::MutableSong::setAlbum);
-	readField(fields["DATE"], &MPD::MutableSong::setDate);
-	readField(fields["TRACKNUMBER"], &MPD::MutableSong::setTrack);
-	readField(fields["GENRE"], &MPD::MutableSong::setGenre);
-	readField(fields["COMPOSER"], &MPD::MutableSong::setComposer);
-	readField(fields["PERFORMER"], &MPD::MutableSong::setPerformer);
-	readField(fields["DISCNUMBER"], &MPD::MutableSong::setDisc);
-	readField(fields["COMMENT"], &MPD::MutableSong::setComment);
+	readField(fields["TITLE"], Tags::Title);
+	readField(fields["ARTIST"], Tags::Artist);
+	readField(fields["ALBUMARTIST"], Tags::AlbumArtist);
+	readField(fields["ALBUM"], Tags::Album);
+	readField(fields["DATE"], Tags::Date);
+	readField(fields["TRACKNUMBER"], Tags::Track);
+	readField(fields["GENRE"], Tags::Genre);
+	readField(fields["COMPOSER"], Tags::Composer);
+	readField(fields["PERFORMER"], Tags::Performer);
+	readField(fields["DISCNUMBER"], Tags::Disc);
+	readField(fields["COMMENT"], Tags::Comment);
 }
 
 void clearID3v1Tags(TagLib::ID3v1::Tag *tag)
@@ -172,44 +179,264 @@ void writeXiphComments(const MPD::MutableSong &s, TagLib::Ogg::XiphComment *tag)
 	writeXiph("COMMENT", tagList(s, &MPD::Song::getComment));
 }
 
-}
-
-namespace Tags {//
 
-bool extendedSetSupported(const TagLib::File *f)
-{
-	return dynamic_cast<const TagLib::MPEG::File *>(f)
-	||     dynamic_cast<const TagLib::Ogg::Vorbis::File *>(f)
-	||     dynamic_cast<const TagLib::FLAC::File *>(f);
-}
+const MPD::MutableSong::SetFunction TagSetters[Tags::TypeCount] = {
+	&MPD::MutableSong::setTitle,
+	&MPD::MutableSong::setArtist,
+	&MPD::MutableSong::setAlbumArtist,
+	&MPD::MutableSong::setAlbum,
+	&MPD::MutableSong::setDate,
+	&MPD::MutableSong::setTrack,
+	&MPD::MutableSong::setGenre,
+	&MPD::MutableSong::setComposer,
+	&MPD::MutableSong::setPerformer,
+	&MPD::MutableSong::setDisc,
+	&MPD::MutableSong::setComment
+};
 
-void read(MPD::MutableSong &s)
+bool readFile(const std::string &path, Tags::FileInfo &info)
 {
-	TagLib::FileRef f(s.getURI().c_str());
+	TagLib::FileRef f(path.c_str());
 	if (f.isNull())
-		return;
+		return false;
 	
-	s.setDuration(f.audioProperties()->length());
+	if (auto properties = f.audioProperties())
+	{
+		info.Duration = properties->length();
+		info.Bitrate = properties->bitrate();
+		info.SampleRate = properties->sampleRate();
+		info.Channels = properties->channels();
+	}
+	info.ExtendedSetSupported = Tags::extendedSetSupported(f.file());
 	
 	if (auto mpeg_file = dynamic_cast<TagLib::MPEG::File *>(f.file()))
 	{
 		if (auto id3v1 = mpeg_file->ID3v1Tag())
-			readID3v1Tags(s, id3v1);
+			readID3v1Tags(info, id3v1);
 		if (auto id3v2 = mpeg_file->ID3v2Tag())
-			readID3v2Tags(s, id3v2);
+			readID3v2Tags(info, id3v2);
 	}
 	else if (auto ogg_file = dynamic_cast<TagLib::Ogg::Vorbis::File *>(f.file()))
 	{
 		if (auto xiph = ogg_file->tag())
-			readXiphComments(s, xiph);
+			readXiphComments(info, xiph);
 	}
 	else if (auto flac_file = dynamic_cast<TagLib::FLAC::File *>(f.file()))
 	{
 		if (auto xiph = flac_file->xiphComment())
-			readXiphComments(s, xiph);
+			readXiphComments(info, xiph);
+	}
+	else
+		readCommonTags(info, f.tag());
+	return true;
+}
+
+/**********************************************************************/
+
+struct CacheEntry
+{
+	off_t Size;
+	time_t MTime;
+	Tags::FileInfo Info;
+	std::list<const std::string *>::iterator Position;
+};
+
+// tag editor writes files using several threads, hence the lock
+pthread_mutex_t CacheLock = PTHREAD_MUTEX_INITIALIZER;
+std::map<std::string, CacheEntry> Cache;
+// paths of cached files, from the least to the most recently used
+std::list<const std::string *> CacheOrder;
+size_t CacheSize = 0;
+bool CacheLoaded = false;
+bool CacheModified = false;
+
+const char CacheHeader[] = "ncmpcpp tags cache 1";
+
+std::string cacheFile()
+{
+	return Config.ncmpcpp_directory + "tags_cache";
+}
+
+// cache is stored as one line per file with tab separated
+// fields, so tabs and newlines in tags have to be escaped.
+void escape(std::ostream &out, const std::string &s)
+{
+	for (auto it = s.begin(); it != s.end(); ++it)
+	{
+		switch (*it)
+		{
+			case '\\':
+				out << "\\\\";
+				break;
+			case '\t':
+				out << "\\t";
+				break;
+			case '\n':
+				out << "\\n";
+				break;
+			default:
+				out << *it;
+		}
+	}
+}
+
+void splitEscaped(const std::string &line, std::vector<std::string> &fields)
+{
+	fields.assign(1, std::string());
+	for (auto it = line.begin(); it != line.end(); ++it)
+	{
+		if (*it == '\t')
+			fields.push_back(std::string());
+		else if (*it == '\\' && it+1 != line.end())
+		{
+			++it;
+			fields.back() += *it == 't' ? '\t' : (*it == 'n' ? '\n' : *it);
+		}
+		else
+			fields.back() += *it;
+	}
+}
+
+void trimCache()
+{
+	while (Cache.size() > CacheSize)
+	{
+		Cache.erase(*CacheOrder.front());
+		CacheOrder.pop_front();
+		CacheModified = true;
+	}
+}
+
+void storeInCache(const std::string &path, off_t size, time_t mtime, const Tags::FileInfo &info)
+{
+	auto it = Cache.find(path);
+	if (it == Cache.end())
+	{
+		it = Cache.insert(std::make_pair(path, CacheEntry())).first;
+		it->second.Position = CacheOrder.insert(CacheOrder.end(), &it->first);
 	}
 	else
-		readCommonTags(s, f.tag());
+		CacheOrder.splice(CacheOrder.end(), CacheOrder, it->second.Position);
+	it->second.Size = size;
+	it->second.MTime = mtime;
+	it->second.Info = info;
+	CacheModified = true;
+	trimCache();
+}
+
+void loadCache()
+{
+	CacheLoaded = true;
+	std::ifstream input(cacheFile().c_str());
+	std::string line;
+	if (!getline(input, line) || line != CacheHeader)
+		return;
+	std::vector<std::string> fields;
+	while (getline(input, line))
+	{
+		// path, size, mtime, duration, bitrate, sample rate, channels,
+		// extended set support and for each tag number of its values
+		// followed by them.
+		splitEscaped(line, fields);
+		if (fields.size() < 8+Tags::TypeCount)
+			continue;
+		Tags::FileInfo info;
+		info.Duration = strtoul(fields[3].c_str(), 0, 10);
+		info.Bitrate = strtoul(fields[4].c_str(), 0, 10);
+		info.SampleRate = strtoul(fields[5].c_str(), 0, 10);
+		info.Channels = strtoul(fields[6].c_str(), 0, 10);
+		info.ExtendedSetSupported = fields[7] == "1";
+		size_t i = 8;
+		for (size_t type = 0; type < Tags::TypeCount && i < fields.size(); ++type)
+		{
+			size_t count = strtoul(fields[i++].c_str(), 0, 10);
+			if (count > fields.size()-i)
+				break;
+			info.Values[type].assign(fields.begin()+i, fields.begin()+i+count);
+			i += count;
+		}
+		if (i != fields.size())
+			continue;
+		storeInCache(fields[0], strtoll(fields[1].c_str(), 0, 10), strtoll(fields[2].c_str(), 0, 10), info);
+	}
+	CacheModified = false;
+}
+
+void removeFromCache(const std::string &path)
+{
+	pthread_mutex_lock(&CacheLock);
+	if (!CacheLoaded && CacheSize > 0)
+		loadCache();
+	auto it = Cache.find(path);
+	if (it != Cache.end())
+	{
+		CacheOrder.erase(it->second.Position);
+		Cache.erase(it);
+		CacheModified = true;
+	}
+	pthread_mutex_unlock(&CacheLock);
+}
+
+}
+
+namespace Tags {//
+
+void FileInfo::set(Type type, std::string value, unsigned idx)
+{
+	if (Values[type].size() <= idx)
+		Values[type].resize(idx+1);
+	Values[type][idx] = std::move(value);
+}
+
+bool extendedSetSupported(const TagLib::File *f)
+{
+	return dynamic_cast<const TagLib::MPEG::File *>(f)
+	||     dynamic_cast<const TagLib::Ogg::Vorbis::File *>(f)
+	||     dynamic_cast<const TagLib::FLAC::File *>(f);
+}
+
+bool read(const std::string &path, FileInfo &info)
+{
+	struct stat file_stat;
+	if (CacheSize == 0 || stat(path.c_str(), &file_stat) != 0)
+		return readFile(path, info);
+	
+	pthread_mutex_lock(&CacheLock);
+	if (!CacheLoaded)
+		loadCache();
+	auto it = Cache.find(path);
+	if (it != Cache.end()
+	&&  it->second.Size == file_stat.st_size
+	&&  it->second.MTime == file_stat.st_mtime)
+	{
+		CacheOrder.splice(CacheOrder.end(), CacheOrder, it->second.Position);
+		info = it->second.Info;
+		pthread_mutex_unlock(&CacheLock);
+		return true;
+	}
+	pthread_mutex_unlock(&CacheLock);
+	
+	if (!readFile(path, info))
+		return false;
+	pthread_mutex_lock(&CacheLock);
+	storeInCache(path, file_stat.st_size, file_stat.st_mtime, info);
+	pthread_mutex_unlock(&CacheLock);
+	return true;
+}
+
+void read(MPD::MutableSong &s)
+{
+	FileInfo info;
+	if (!read(s.getURI(), info))
+		return;
+	
+	s.setDuration(info.Duration);
+	for (size_t type = 0; type < TypeCount; ++type)
+	{
+		auto &values = info.Values[type];
+		for (size_t idx = 0; idx < values.size(); ++idx)
+			(s.*TagSetters[type])(values[idx], idx);
+	}
 }
 
 bool write(MPD::MutableSong &s)
@@ -241,6 +468,9 @@ bool write(MPD::MutableSong &s)
 	
 	if (!f.save())
 		return false;
+	// modification time has resolution of one second,
+	// so it can't be relied upon in this case
+	removeFromCache(old_name);
 	
 	if (!s.getNewURI().empty())
 	{
@@ -248,6 +478,7 @@ bool write(MPD::MutableSong &s)
 		if (s.isFromDatabase())
 			new_name += Config.mpd_music_dir;
 		new_name += s.getDirectory() + "/" + s.getNewURI();
+		removeFromCache(new_name);
 		if (std::rename(old_name.c_str(), new_name.c_str()) == 0 && !s.isFromDatabase())
 		{
 			// FIXME
@@ -273,6 +504,53 @@ bool write(MPD::MutableSong &s)
 	return true;
 }
 
+void setCacheSize(size_t size)
+{
+	pthread_mutex_lock(&CacheLock);
+	CacheSize = size;
+	if (CacheLoaded)
+		trimCache();
+	pthread_mutex_unlock(&CacheLock);
+}
+
+void saveCache()
+{
+	pthread_mutex_lock(&CacheLock);
+	if (CacheModified)
+	{
+		std::string path = cacheFile();
+		std::string tmp_path = path + ".tmp";
+		std::ofstream output(tmp_path.c_str());
+		output << CacheHeader << '\n';
+		for (auto it = CacheOrder.begin(); it != CacheOrder.end(); ++it)
+		{
+			auto &entry = Cache[**it];
+			auto &info = entry.Info;
+			escape(output, **it);
+			output << '\t' << entry.Size << '\t' << entry.MTime
+			       << '\t' << info.Duration << '\t' << info.Bitrate
+			       << '\t' << info.SampleRate << '\t' << info.Channels
+			       << '\t' << info.ExtendedSetSupported;
+			for (size_t type = 0; type < TypeCount; ++type)
+			{
+				output << '\t' << info.Values[type].size();
+				for (auto v = info.Values[type].begin(); v != info.Values[type].end(); ++v)
+				{
+					output << '\t';
+					escape(output, *v);
+				}
+			}
+			output << '\n';
+		}
+		output.close();
+		if (output && std::rename(tmp_path.c_str(), path.c_str()) == 0)
+			CacheModified = false;
+		else
+			std::remove(tmp_path.c_str());
+	}
+	pthread_mutex_unlock(&CacheLock);
+}
+
 }
 
 #endif // HAVE_TAGLIB_H
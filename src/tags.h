@@ -25,16 +25,46 @@
 
 #ifdef HAVE_TAGLIB_H
 
+#include <string>
 #include <tfile.h>
+#include <vector>
 #include "mutable_song.h"
 
 namespace Tags {//
 
+enum Type { Title, Artist, AlbumArtist, Album, Date, Track, Genre, Composer, Performer, Disc, Comment, TypeCount };
+
+/// tags and audio properties of a file
+struct FileInfo
+{
+	FileInfo() : Duration(0), Bitrate(0), SampleRate(0), Channels(0), ExtendedSetSupported(false) { }
+	
+	void set(Type type, std::string value, unsigned idx);
+	
+	unsigned Duration;
+	unsigned Bitrate;
+	unsigned SampleRate;
+	unsigned Channels;
+	bool ExtendedSetSupported;
+	std::vector<std::string> Values[TypeCount];
+};
+
 bool extendedSetSupported(const TagLib::File *f);
 
+/// reads tags of the file. results are cached and reused
+/// as long as size and modification time of the file
+/// don't change, so reading it again is cheap.
+bool read(const std::string &path, FileInfo &info);
+
 void read(MPD::MutableSong &);
 bool write(MPD::MutableSong &);
 
+/// sets maximal number of files the cache can hold
+void setCacheSize(size_t size);
+/// stores the cache in ncmpcpp directory, so that it
+/// can be used in next session
+void saveCache();
+
 }
 
 #endif // HAVE_TAGLIB_H
@@ -0,0 +1,98 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2012 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+
+#include <cstring>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "timers.h"
+
+#if defined(HAVE_SYS_TIMERFD_H) && !defined(USE_PDCURSES)
+# include <sys/timerfd.h>
+# define TIMERS_USE_TIMERFD 1
+#endif
+
+namespace {//
+
+#ifdef TIMERS_USE_TIMERFD
+int TimerFD = -2;
+// earliest requested time, valid only if timer is armed
+bool Armed = false;
+timeval Deadline;
+#endif // TIMERS_USE_TIMERFD
+
+}
+
+void Timers::wakeUpAt(const timeval &when)
+{
+#	ifdef TIMERS_USE_TIMERFD
+	if (fd() < 0)
+		return;
+	timeval now;
+	gettimeofday(&now, 0);
+	// pending request that comes first takes precedence
+	if (Armed && timercmp(&Deadline, &now, >) && !timercmp(&when, &Deadline, <))
+		return;
+	// expiration time equal to zero would disarm the timer
+	itimerspec spec;
+	memset(&spec, 0, sizeof(spec));
+	spec.it_value.tv_sec = when.tv_sec;
+	spec.it_value.tv_nsec = when.tv_usec*1000 + 1;
+	if (timerfd_settime(TimerFD, TFD_TIMER_ABSTIME, &spec, 0) == 0)
+	{
+		Armed = true;
+		Deadline = when;
+	}
+#	else
+	(void)when;
+#	endif // TIMERS_USE_TIMERFD
+}
+
+void Timers::wakeUpAfter(unsigned msec)
+{
+	timeval when, delay = { time_t(msec/1000), suseconds_t((msec%1000)*1000) };
+	gettimeofday(&when, 0);
+	timeradd(&when, &delay, &when);
+	wakeUpAt(when);
+}
+
+int Timers::fd()
+{
+#	ifdef TIMERS_USE_TIMERFD
+	// wall clock is used since requested times are based on gettimeofday()
+	if (TimerFD == -2)
+		TimerFD = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+	return TimerFD;
+#	else
+	return -1;
+#	endif // TIMERS_USE_TIMERFD
+}
+
+void Timers::processExpired()
+{
+#	ifdef TIMERS_USE_TIMERFD
+	uint64_t expirations;
+	ssize_t res = read(TimerFD, &expirations, sizeof(expirations));
+	(void)res;
+	Armed = false;
+#	endif // TIMERS_USE_TIMERFD
+}
@@ -0,0 +1,49 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2012 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+
+#ifndef _TIMERS_H
+#define _TIMERS_H
+
+#include <sys/time.h>
+
+/// Lets parts of the program request waking up the main loop at given
+/// time, so that it can sleep until something has to be done instead of
+/// waking up regularly. Requests are forgotten once the main loop wakes
+/// up, so they have to be repeated as long as they are needed.
+namespace Timers {//
+
+/// makes main loop wake up at given time at the latest
+void wakeUpAt(const timeval &when);
+
+/// makes main loop wake up after given number of milliseconds at the latest
+void wakeUpAfter(unsigned msec);
+
+/// @return descriptor that becomes readable at the earliest requested
+/// time or -1 if it's not supported, in which case main loop has to
+/// wake up regularly
+int fd();
+
+/// acknowledges that the descriptor became readable
+void processExpired();
+
+}
+
+#endif // _TIMERS_H
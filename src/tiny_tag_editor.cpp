@@ -22,10 +22,6 @@
 
 #ifdef HAVE_TAGLIB_H
 
-// taglib includes
-#include <fileref.h>
-#include <tag.h>
-
 #include "browser.h"
 #include "charset.h"
 #include "display.h"
@@ -174,10 +170,11 @@ bool TinyTagEditor::getTags()
 		path_to_file += Config.mpd_music_dir;
 	path_to_file += itsEdited.getURI();
 	
-	TagLib::FileRef f(path_to_file.c_str());
-	if (f.isNull())
+	Tags::FileInfo info;
+	if (!Tags::read(path_to_file, info))
 		return false;
-	itsEdited.setComment(f.tag()->comment().to8Bit(1));
+	auto &comments = info.Values[Tags::Comment];
+	itsEdited.setComment(comments.empty() ? "" : comments.front());
 	
 	std::string ext = itsEdited.getURI();
 	ext = lowercase(ext.substr(ext.rfind(".")+1));
@@ -194,7 +191,7 @@ bool TinyTagEditor::getTags()
 	w.at(19).setSeparator(true);
 	w.at(21).setSeparator(true);
 	
-	if (!Tags::extendedSetSupported(f.file()))
+	if (!info.ExtendedSetSupported)
 	{
 		w.at(10).setInactive(true);
 		for (size_t i = 15; i <= 17; ++i)
@@ -208,9 +205,9 @@ bool TinyTagEditor::getTags()
 	ShowTag(w.at(1).value(), itsEdited.getDirectory());
 	w.at(1).value() << NC::clEnd;
 	w.at(3).value() << NC::fmtBold << Config.color1 << "Length: " << NC::fmtBoldEnd << Config.color2 << itsEdited.getLength() << NC::clEnd;
-	w.at(4).value() << NC::fmtBold << Config.color1 << "Bitrate: " << NC::fmtBoldEnd << Config.color2 << f.audioProperties()->bitrate() << " kbps" << NC::clEnd;
-	w.at(5).value() << NC::fmtBold << Config.color1 << "Sample rate: " << NC::fmtBoldEnd << Config.color2 << f.audioProperties()->sampleRate() << " Hz" << NC::clEnd;
-	w.at(6).value() << NC::fmtBold << Config.color1 << "Channels: " << NC::fmtBoldEnd << Config.color2 << (f.audioProperties()->channels() == 1 ? "Mono" : "Stereo") << NC::clDefault;
+	w.at(4).value() << NC::fmtBold << Config.color1 << "Bitrate: " << NC::fmtBoldEnd << Config.color2 << info.Bitrate << " kbps" << NC::clEnd;
+	w.at(5).value() << NC::fmtBold << Config.color1 << "Sample rate: " << NC::fmtBoldEnd << Config.color2 << info.SampleRate << " Hz" << NC::clEnd;
+	w.at(6).value() << NC::fmtBold << Config.color1 << "Channels: " << NC::fmtBoldEnd << Config.color2 << (info.Channels == 1 ? "Mono" : "Stereo") << NC::clDefault;
 	
 	unsigned pos = 8;
 	for (const SongInfo::Metadata *m = SongInfo::Tags; m->Name; ++m, ++pos)
@@ -18,33 +18,91 @@
  *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
  ***************************************************************************/
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
 #include "utility/html.h"
-#include "utility/string.h"
+
+namespace {//
+
+void appendUtf8(std::string &s, unsigned long n)
+{
+	if (n >= 0x10000)
+	{
+		s += char(0xf0 | ((n >> 18) & 0x07));
+		s += char(0x80 | ((n >> 12) & 0x3f));
+		s += char(0x80 | ((n >> 6) & 0x3f));
+		s += char(0x80 | (n & 0x3f));
+	}
+	else if (n >= 0x800)
+	{
+		s += char(0xe0 | ((n >> 12) & 0x0f));
+		s += char(0x80 | ((n >> 6) & 0x3f));
+		s += char(0x80 | (n & 0x3f));
+	}
+	else if (n >= 0x80)
+	{
+		s += char(0xc0 | ((n >> 6) & 0x1f));
+		s += char(0x80 | (n & 0x3f));
+	}
+	else
+		s += char(n);
+}
+
+// appends decoded entity that begins at s[i] to the result and
+// moves i to its last character. only numeric entities are decoded
+// unless named is true. entities are short, so their end is looked
+// for only in a few following characters to keep the whole pass linear.
+bool appendEntity(const std::string &s, size_t &i, std::string &result, bool named)
+{
+	const size_t max_length = 10;
+	const char *semicolon = static_cast<const char *>(
+		memchr(s.c_str()+i, ';', std::min(max_length+1, s.length()-i)));
+	if (!semicolon)
+		return false;
+	size_t end = semicolon-s.c_str();
+	const char *entity = s.c_str()+i+1;
+	size_t length = end-i-1;
+	if (length > 1 && entity[0] == '#')
+	{
+		char *parsed;
+		unsigned long n = entity[1] == 'x' || entity[1] == 'X'
+			? strtoul(entity+2, &parsed, 16)
+			: strtoul(entity+1, &parsed, 10);
+		if (parsed != s.c_str()+end || n == 0 || n > 0x10ffff)
+			return false;
+		appendUtf8(result, n);
+	}
+	else if (!named)
+		return false;
+	else if (!s.compare(i+1, length, "amp"))
+		result += '&';
+	else if (!s.compare(i+1, length, "quot"))
+		result += '"';
+	else if (!s.compare(i+1, length, "apos"))
+		result += '\'';
+	else if (!s.compare(i+1, length, "nbsp"))
+		result += ' ';
+	else if (!s.compare(i+1, length, "lt"))
+		result += '<';
+	else if (!s.compare(i+1, length, "gt"))
+		result += '>';
+	else
+		return false;
+	i = end;
+	return true;
+}
+
+}
 
 std::string unescapeHtmlUtf8(const std::string &data)
 {
 	std::string result;
-	for (size_t i = 0, j; i < data.length(); ++i)
+	result.reserve(data.length());
+	for (size_t i = 0; i < data.length(); ++i)
 	{
-		if (data[i] == '&' && data[i+1] == '#' && (j = data.find(';', i)) != std::string::npos)
-		{
-			int n = atoi(&data.c_str()[i+2]);
-			if (n >= 0x800)
-			{
-				result += (0xe0 | ((n >> 12) & 0x0f));
-				result += (0x80 | ((n >> 6) & 0x3f));
-				result += (0x80 | (n & 0x3f));
-			}
-			else if (n >= 0x80)
-			{
-				result += (0xc0 | ((n >> 6) & 0x1f));
-				result += (0x80 | (n & 0x3f));
-			}
-			else
-				result += n;
-			i = j;
-		}
-		else
+		if (data[i] != '&' || !appendEntity(data, i, result, false))
 			result += data[i];
 	}
 	return result;
@@ -52,29 +110,70 @@ std::string unescapeHtmlUtf8(const std::string &data)
 
 void stripHtmlTags(std::string &s)
 {
-	bool erase = 0;
-	for (size_t i = s.find("<"); i != std::string::npos; i = s.find("<"))
-	{
-		size_t j = s.find(">", i)+1;
-		s.replace(i, j-i, "");
-	}
-	replace(s, "&#039;", "'");
-	replace(s, "&amp;", "&");
-	replace(s, "&quot;", "\"");
-	replace(s, "&nbsp;", " ");
+	// tags are removed, entities decoded and line endings
+	// normalized in one pass instead of replacing in place
+	std::string result;
+	result.reserve(s.length());
 	for (size_t i = 0; i < s.length(); ++i)
 	{
-		if (erase)
+		switch (s[i])
 		{
-			s.erase(s.begin()+i);
-			erase = 0;
+			case '<':
+				i = s.find('>', i);
+				if (i == std::string::npos)
+					i = s.length();
+				break;
+			case '&':
+				if (!appendEntity(s, i, result, true))
+					result += '&';
+				break;
+			case '\r': // windows line ending
+				result += '\n';
+				if (i+1 < s.length() && s[i+1] == '\n')
+					++i;
+				break;
+			case '\t':
+				result += ' ';
+				break;
+			default:
+				result += s[i];
 		}
-		if (s[i] == 13) // ascii code for windows line ending, get rid of this shit
+	}
+	s.swap(result);
+}
+
+HtmlExtractor::HtmlExtractor(const std::string &open_tag, const std::string &close_tag)
+: m_open_tag(open_tag), m_close_tag(close_tag), m_state(State::Searching)
+{ }
+
+bool HtmlExtractor::feed(const char *data, size_t length)
+{
+	if (m_state == State::Done)
+		return false;
+	m_pending.append(data, length);
+	if (m_state == State::Searching)
+	{
+		size_t i = m_pending.find(m_open_tag);
+		if (i == std::string::npos)
 		{
-			s[i] = '\n';
-			erase = 1;
+			// keep only the part that may be the beginning of the tag
+			if (m_pending.length() >= m_open_tag.length())
+				m_pending.erase(0, m_pending.length()-m_open_tag.length()+1);
+			return true;
 		}
-		else if (s[i] == '\t')
-			s[i] = ' ';
+		m_pending.erase(0, i+m_open_tag.length());
+		m_state = State::Extracting;
+	}
+	size_t i = m_pending.find(m_close_tag);
+	if (i == std::string::npos)
+	{
+		size_t keep = std::min(m_pending.length(), m_close_tag.length()-1);
+		m_content.append(m_pending, 0, m_pending.length()-keep);
+		m_pending.erase(0, m_pending.length()-keep);
+		return true;
 	}
-}
\ No newline at end of file
+	m_content.append(m_pending, 0, i);
+	m_pending.clear();
+	m_state = State::Done;
+	return false;
+}
@@ -27,4 +27,28 @@ std::string unescapeHtmlUtf8(const std::string &s);
 
 void stripHtmlTags(std::string &s);
 
+/// Extracts part of html page between two tags while the page is being
+/// received, so it can be fed with chunks of data straight from curl and
+/// the transfer can be stopped as soon as the closing tag arrives.
+class HtmlExtractor
+{
+	enum class State { Searching, Extracting, Done };
+	
+	std::string m_open_tag;
+	std::string m_close_tag;
+	// received data that may contain beginning of searched tag
+	std::string m_pending;
+	std::string m_content;
+	State m_state;
+	
+public:
+	HtmlExtractor(const std::string &open_tag, const std::string &close_tag);
+	
+	/// @return false if closing tag was found and no more data is needed
+	bool feed(const char *data, size_t length);
+	
+	bool found() const { return m_state == State::Done; }
+	std::string &content() { return m_content; }
+};
+
 #endif // _UTILITY_HTML
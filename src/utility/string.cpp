@@ -66,8 +66,24 @@ std::vector<std::string> split(const std::string &s, const std::string &delimite
 
 void replace(std::string &s, const std::string &from, const std::string &to)
 {
-	for (size_t i = 0; (i = s.find(from, i)) != std::string::npos; i += to.length())
-		s.replace(i, from.length(), to);
+	if (from.empty())
+		return;
+	size_t i = s.find(from);
+	if (i == std::string::npos)
+		return;
+	// build the result instead of replacing in place, which
+	// would move the rest of the string for each occurrence
+	std::string result;
+	result.reserve(s.length());
+	size_t last = 0;
+	for (; i != std::string::npos; i = s.find(from, last))
+	{
+		result.append(s, last, i-last);
+		result += to;
+		last = i+from.length();
+	}
+	result.append(s, last, std::string::npos);
+	s.swap(result);
 }
 
 void lowercase(std::string &s)
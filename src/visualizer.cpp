@@ -22,12 +22,18 @@
 
 #ifdef ENABLE_VISUALIZER
 
+#include <algorithm>
 #include <cerrno>
 #include <cmath>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
+#include <atomic>
 #include <limits>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -35,6 +41,7 @@
 #include "settings.h"
 #include "status.h"
 #include "statusbar.h"
+#include "timers.h"
 #include "title.h"
 #include "screen_switcher.h"
 
@@ -43,19 +50,300 @@ using Global::MainHeight;
 
 Visualizer *myVisualizer;
 
-const int Visualizer::WindowTimeout = 1000/25; /* 25 fps */
+namespace {//
+
+// time between frames in milliseconds, set from visualizer_fps
+int FrameInterval = 1000/25;
+
+/// PCM data is read from the fifo by a separate thread as soon as it
+/// arrives, so that visualization doesn't depend on how fast the main
+/// loop is. It's put into a ring buffer, from which newest samples
+/// are taken, and the main loop is woken up when a new frame is due.
+namespace Capture {//
+
+const size_t BufferSize = 1 << 17; // power of 2
+
+/// format of PCM data read from the fifo
+struct Format
+{
+	unsigned rate;
+	unsigned bits;
+	bool is_float;
+	unsigned channels;
+};
+
+// samples are kept as floats in the range of 16 bit ones
+float Buffer[BufferSize];
+// number of samples written so far, only capture thread modifies it
+std::atomic<uint64_t> Written(0);
+// number of times data piled up in the fifo had to be skipped
+std::atomic<unsigned> Skips(0);
+
+std::atomic<bool> Paused(false);
+pthread_t Thread;
+bool Running = false;
+int Fifo;
+Format PCM;
+size_t SampleSize;
+size_t FrameSize;
+// capture thread notifies main one through the first pipe
+// and is told to stop through the second one
+int NotifyFD[2], StopFD[2];
+bool FrameReady = false;
+
+/// converts samples to floats. format is checked outside of the
+/// loops so that the compiler can vectorize each of them.
+void convert(const char *data, size_t count, float *output)
+{
+	if (PCM.is_float)
+	{
+		const float *samples = reinterpret_cast<const float *>(data);
+		for (size_t i = 0; i < count; ++i)
+			output[i] = samples[i]*32767.0f;
+	}
+	else if (PCM.bits == 16)
+	{
+		const int16_t *samples = reinterpret_cast<const int16_t *>(data);
+		for (size_t i = 0; i < count; ++i)
+			output[i] = samples[i];
+	}
+	else
+	{
+		// 24 bit samples are padded to 32 bits by mpd
+		const int32_t *samples = reinterpret_cast<const int32_t *>(data);
+		const float scale = PCM.bits == 24 ? 1.0f/256 : 1.0f/65536;
+		for (size_t i = 0; i < count; ++i)
+			output[i] = samples[i]*scale;
+	}
+}
+
+void *capture(void *)
+{
+	// int32_t makes the buffer suitably aligned for every sample type
+	int32_t storage[4096];
+	char *data = reinterpret_cast<char *>(storage);
+	const size_t data_size = sizeof(storage);
+	float converted[sizeof(storage)/sizeof(int16_t)];
+	size_t pending = 0;
+	timeval last_notify = { 0, 0 };
+	pollfd fds[2] = { { Fifo, POLLIN, 0 }, { StopFD[0], POLLIN, 0 } };
+	// fifo can't hold more data than its capacity, so falling behind has to
+	// be detected before it fills up, even if that's less than fifth of a second.
+	size_t fifo_size = 65536;
+#	ifdef F_GETPIPE_SZ
+	int size = fcntl(Fifo, F_GETPIPE_SZ);
+	if (size > 0)
+		fifo_size = size;
+#	endif // F_GETPIPE_SZ
+	const size_t max_backlog = std::min(PCM.rate/5*FrameSize, fifo_size/4*3);
+	while (true)
+	{
+		if (poll(fds, 2, -1) < 0)
+			continue;
+		if (fds[1].revents)
+			break;
+		// if more than fifth of a second of data is waiting in the fifo, this
+		// thread fell behind, so skip all of it except the newest part, keeping
+		// alignment of frames. only whole frames are skipped.
+		int available;
+		if (ioctl(Fifo, FIONREAD, &available) == 0 && size_t(available) > max_backlog
+		&&  size_t(available) > data_size)
+		{
+			size_t skip = available-data_size;
+			skip -= skip%FrameSize;
+			while (skip > 0)
+			{
+				ssize_t n = read(Fifo, data+pending, std::min(skip, data_size-pending));
+				if (n <= 0)
+					break;
+				skip -= n;
+			}
+			++Skips;
+		}
+		ssize_t n = read(Fifo, data+pending, data_size-pending);
+		if (n <= 0)
+		{
+			// there is no writer, wait for one without spinning
+			if (n == 0 || errno != EAGAIN)
+				if (poll(&fds[1], 1, 100) > 0)
+					break;
+			continue;
+		}
+		// only whole frames are put into the buffer so that
+		// channels of stereo samples are never mixed up.
+		pending += n;
+		size_t usable = pending - pending%FrameSize;
+		size_t count = usable/SampleSize;
+		convert(data, count, converted);
+		// converted samples are copied into the ring buffer in at most two pieces
+		uint64_t written = Written.load(std::memory_order_relaxed);
+		size_t begin = written & (BufferSize-1);
+		size_t first = std::min(count, BufferSize-begin);
+		std::copy(converted, converted+first, Buffer+begin);
+		std::copy(converted+first, converted+count, Buffer);
+		Written.store(written+count, std::memory_order_release);
+		memmove(data, data+usable, pending-usable);
+		pending -= usable;
+		
+		timeval now;
+		gettimeofday(&now, 0);
+		if (!Paused.load(std::memory_order_relaxed)
+		&&  (now.tv_sec-last_notify.tv_sec)*1000+(now.tv_usec-last_notify.tv_usec)/1000 >= FrameInterval)
+		{
+			char one = 1;
+			// if it fails, main thread wasn't woken up by previous notification yet
+			GNUC_UNUSED ssize_t res;
+			res = write(NotifyFD[1], &one, 1);
+			last_notify = now;
+		}
+	}
+	return 0;
+}
+
+// called by main loop when notification arrives
+void notified()
+{
+	char data[64];
+	while (read(NotifyFD[0], data, sizeof(data)) > 0) { }
+	// there is no point in waking up the main loop
+	// if no one is going to see the result
+	if (isVisible(myVisualizer))
+		FrameReady = true;
+	else
+		Paused = true;
+}
+
+bool start(int fifo, const Format &format)
+{
+	if (pipe(NotifyFD) != 0)
+		return false;
+	if (pipe(StopFD) != 0)
+	{
+		close(NotifyFD[0]);
+		close(NotifyFD[1]);
+		return false;
+	}
+	for (size_t i = 0; i < 2; ++i)
+	{
+		fcntl(NotifyFD[i], F_SETFL, fcntl(NotifyFD[i], F_GETFL) | O_NONBLOCK);
+		fcntl(NotifyFD[i], F_SETFD, FD_CLOEXEC);
+		fcntl(StopFD[i], F_SETFD, FD_CLOEXEC);
+	}
+	Fifo = fifo;
+	PCM = format;
+	SampleSize = PCM.bits == 16 ? sizeof(int16_t) : sizeof(int32_t);
+	FrameSize = SampleSize*PCM.channels;
+	Written = 0;
+	Skips = 0;
+	Paused = false;
+	FrameReady = false;
+	Running = pthread_create(&Thread, 0, capture, 0) == 0;
+	if (Running)
+		Global::wFooter->addFDCallback(NotifyFD[0], notified);
+	return Running;
+}
+
+void stop()
+{
+	if (!Running)
+		return;
+	char one = 1;
+	GNUC_UNUSED ssize_t res;
+	res = write(StopFD[1], &one, 1);
+	pthread_join(Thread, 0);
+	Running = false;
+	Global::wFooter->removeFDCallback(NotifyFD[0]);
+	for (size_t i = 0; i < 2; ++i)
+	{
+		close(NotifyFD[i]);
+		close(StopFD[i]);
+	}
+}
+
+/// copies newest samples into the buffer. capture thread writes far
+/// enough ahead of them not to overwrite them while they're copied.
+/// @return number of copied samples
+size_t newest(float *buffer, size_t count)
+{
+	uint64_t written = Written.load(std::memory_order_acquire);
+	count = std::min(uint64_t(count), written);
+	size_t begin = (written-count) & (BufferSize-1);
+	size_t first = std::min(count, BufferSize-begin);
+	std::copy(Buffer+begin, Buffer+begin+first, buffer);
+	std::copy(Buffer, Buffer+count-first, buffer+first);
+	return count;
+}
+
+}
+
+// how many samples of each channel are visualized at once. it's the
+// smallest power of 2 covering time between frames, so that spectrum
+// resolution is the same regardless of sample rate. with frame rates
+// above 25 fps consecutive frames overlap instead of getting shorter.
+unsigned samplesPerFrame(unsigned rate)
+{
+	unsigned samples = 256;
+	while (samples < rate*std::max(FrameInterval, 1000/25)/1000)
+		samples *= 2;
+	return samples;
+}
+
+#ifdef HAVE_FFTW3_H
+// measuring the best plan takes a while, so
+// it's saved and reused on subsequent runs
+std::string wisdomPath()
+{
+	return Config.ncmpcpp_directory + "fftw_wisdom";
+}
+
+void importWisdom()
+{
+	if (FILE *f = fopen(wisdomPath().c_str(), "r"))
+	{
+		fftwf_import_wisdom_from_file(f);
+		fclose(f);
+	}
+}
+
+void exportWisdom()
+{
+	if (FILE *f = fopen(wisdomPath().c_str(), "w"))
+	{
+		fftwf_export_wisdom_to_file(f);
+		fclose(f);
+	}
+}
+#endif // HAVE_FFTW3_H
+
+}
 
 Visualizer::Visualizer()
 : Screen(NC::Window(0, MainStartY, COLS, MainHeight, "", Config.visualizer_color, NC::brNone))
+, m_fifo(-1), m_skips(0), m_sync_in_progress(false)
 {
 	ResetFD();
-	m_samples = Config.visualizer_in_stereo ? 4096 : 2048;
+	FrameInterval = 1000/Config.visualizer_fps;
+	m_sample_rate = Config.visualizer_sample_rate;
+	if (Config.visualizer_channels)
+		m_channels = Config.visualizer_channels;
+	else
+		m_channels = Config.visualizer_in_stereo ? 2 : 1;
+	m_samples = samplesPerFrame(m_sample_rate);
+	m_sample_buffer.resize(m_samples*m_channels);
+	m_left_samples.resize(m_samples);
+	if (m_channels == 2 && Config.visualizer_in_stereo)
+		m_right_samples.resize(m_samples);
 #	ifdef HAVE_FFTW3_H
 	m_fftw_results = m_samples/2+1;
-	m_freq_magnitudes = new unsigned[m_fftw_results];
-	m_fftw_input = static_cast<double *>(fftw_malloc(sizeof(double)*m_samples));
-	m_fftw_output = static_cast<fftw_complex *>(fftw_malloc(sizeof(fftw_complex)*m_fftw_results));
-	m_fftw_plan = fftw_plan_dft_r2c_1d(m_samples, m_fftw_input, m_fftw_output, FFTW_ESTIMATE);
+	m_freq_magnitudes.resize(m_fftw_results);
+	m_fftw_input = static_cast<float *>(fftwf_malloc(sizeof(float)*m_samples));
+	m_fftw_output = static_cast<fftwf_complex *>(fftwf_malloc(sizeof(fftwf_complex)*m_fftw_results));
+	// plan is made when the visualizer is shown for the first time
+	m_fftw_plan = 0;
+	// hann window reduces leakage between frequencies
+	m_fftw_window.resize(m_samples);
+	for (unsigned i = 0; i < m_samples; ++i)
+		m_fftw_window[i] = 0.5f*(1.0f-cosf(2.0f*M_PI*i/(m_samples-1)));
 #	endif // HAVE_FFTW3_H
 	
 	FindOutputID();
@@ -64,11 +352,13 @@ Visualizer::Visualizer()
 void Visualizer::switchTo()
 {
 	SwitchTo::execute(this);
+#	ifdef HAVE_FFTW3_H
+	PlanFFT();
+#	endif // HAVE_FFTW3_H
 	w.clear();
+	m_prev_cells.clear();
 	SetFD();
 	m_timer = { 0, 0 };
-	if (m_fifo >= 0)
-		Global::wFooter->setTimeout(WindowTimeout);
 	drawHeader();
 }
 
@@ -78,6 +368,7 @@ void Visualizer::resize()
 	getWindowResizeParams(x_offset, width);
 	w.resize(width, MainHeight);
 	w.moveTo(x_offset, MainStartY);
+	m_prev_cells.clear();
 	hasToBeResized = 0;
 }
 
@@ -91,21 +382,17 @@ void Visualizer::update()
 	if (m_fifo < 0)
 		return;
 	
-	// PCM in format 44100:16:1 (for mono visualization) and 44100:16:2 (for stereo visualization) is supported
-	int16_t buf[m_samples];
-	ssize_t data = read(m_fifo, buf, sizeof(buf));
-	if (data < 0) // no data available in fifo
+	Capture::Paused = false;
+	if (!Capture::FrameReady)
 		return;
+	Capture::FrameReady = false;
 	
-	if (m_output_id != -1 && Global::Timer.tv_sec > m_timer.tv_sec+Config.visualizer_sync_interval)
-	{
-		Mpd.DisableOutput(m_output_id);
-		usleep(50000);
-		Mpd.EnableOutput(m_output_id);
-		m_timer = Global::Timer;
-	}
+	const float *buf = &m_sample_buffer[0];
+	ssize_t samples = Capture::newest(&m_sample_buffer[0], m_samples*m_channels)/m_channels;
+	if (samples == 0)
+		return;
 	
-	void (Visualizer::*draw)(int16_t *, ssize_t, size_t, size_t);
+	void (Visualizer::*draw)(const float *, ssize_t, size_t, size_t);
 #	ifdef HAVE_FFTW3_H
 	if (!Config.visualizer_use_wave)
 		draw = &Visualizer::DrawFrequencySpectrum;
@@ -113,25 +400,75 @@ void Visualizer::update()
 #	endif // HAVE_FFTW3_H
 		draw = &Visualizer::DrawSoundWave;
 	
-	w.clear();
-	ssize_t samples_read = data/sizeof(int16_t);
-	if (Config.visualizer_in_stereo)
+	// contents of the window are known only if size of the
+	// previous frame matches, otherwise it's drawn from scratch.
+	const size_t cells = w.getWidth()*w.getHeight();
+	if (m_prev_cells.size() != cells)
+	{
+		w.clear();
+		m_prev_cells.assign(cells, Cell::Empty);
+		m_cells.assign(cells, Cell::Empty);
+	}
+	
+	float *left = &m_left_samples[0];
+	if (m_channels == 2 && Config.visualizer_in_stereo)
 	{
-		int16_t buf_left[samples_read/2], buf_right[samples_read/2];
-		for (ssize_t i = 0, j = 0; i < samples_read; i += 2, ++j)
+		float *right = &m_right_samples[0];
+		for (ssize_t i = 0; i < samples; ++i)
 		{
-			buf_left[j] = buf[i];
-			buf_right[j] = buf[i+1];
+			left[i] = buf[2*i];
+			right[i] = buf[2*i+1];
 		}
 		size_t half_height = MainHeight/2;
-		(this->*draw)(buf_left, samples_read/2, 0, half_height);
-		(this->*draw)(buf_right, samples_read/2, half_height+(draw == &Visualizer::DrawSoundWave ? 1 : 0), half_height+(draw != &Visualizer::DrawSoundWave ? 1 : 0));
+		(this->*draw)(left, samples, 0, half_height);
+		(this->*draw)(right, samples, half_height+(draw == &Visualizer::DrawSoundWave ? 1 : 0), half_height+(draw != &Visualizer::DrawSoundWave ? 1 : 0));
+	}
+	else if (m_channels == 2)
+	{
+		// stereo data visualized as mono, channels are mixed
+		for (ssize_t i = 0; i < samples; ++i)
+			left[i] = (buf[2*i]+buf[2*i+1])/2;
+		(this->*draw)(left, samples, 0, MainHeight);
 	}
 	else
-		(this->*draw)(buf, samples_read, 0, MainHeight);
+		(this->*draw)(buf, samples, 0, MainHeight);
+	DrawChangedCells();
 	w.refresh();
 }
 
+void Visualizer::Sync()
+{
+	if (m_fifo < 0 || m_output_id == -1)
+		return;
+	
+	// output is enabled again in one of the next iterations of
+	// main loop instead of waiting for mpd to disable it.
+	if (m_sync_in_progress)
+	{
+		if ((Global::Timer.tv_sec-m_timer.tv_sec)*1000+(Global::Timer.tv_usec-m_timer.tv_usec)/1000 >= 50)
+		{
+			Mpd.EnableOutput(m_output_id);
+			m_sync_in_progress = false;
+		}
+		else
+			Timers::wakeUpAfter(50);
+		return;
+	}
+	
+	// skipping stale data is usually enough to keep visualization in
+	// sync. if it keeps piling up, restart the output to get rid of it.
+	unsigned skips = Capture::Skips;
+	if (skips-m_skips >= 3 && isVisible(this)
+	&&  Global::Timer.tv_sec > m_timer.tv_sec+Config.visualizer_sync_interval)
+	{
+		Mpd.DisableOutput(m_output_id);
+		Timers::wakeUpAfter(50);
+		m_sync_in_progress = true;
+		m_timer = Global::Timer;
+		m_skips = skips;
+	}
+}
+
 void Visualizer::spacePressed()
 {
 #	ifdef HAVE_FFTW3_H
@@ -140,7 +477,7 @@ void Visualizer::spacePressed()
 #	endif // HAVE_FFTW3_H
 }
 
-void Visualizer::DrawSoundWave(int16_t *buf, ssize_t samples, size_t y_offset, size_t height)
+void Visualizer::DrawSoundWave(const float *buf, ssize_t samples, size_t y_offset, size_t height)
 {
 	const int samples_per_col = samples/w.getWidth();
 	const int half_height = height/2;
@@ -154,7 +491,7 @@ void Visualizer::DrawSoundWave(int16_t *buf, ssize_t samples, size_t y_offset, s
 		point_pos /= samples_per_col;
 		point_pos /= std::numeric_limits<int16_t>::max();
 		point_pos *= half_height;
-		w << NC::XY(i, y_offset+half_height+point_pos) << Config.visualizer_chars[0];
+		SetCell(i, y_offset+half_height+point_pos, Cell::Wave);
 		if (i && abs(prev_point_pos-point_pos) > 2)
 		{
 			// if gap is too big. intermediate values are needed
@@ -162,41 +499,117 @@ void Visualizer::DrawSoundWave(int16_t *buf, ssize_t samples, size_t y_offset, s
 			const int breakpoint = std::max(prev_point_pos, point_pos);
 			const int half = (prev_point_pos+point_pos)/2;
 			for (int k = std::min(prev_point_pos, point_pos)+1; k < breakpoint; k += 2)
-				w << NC::XY(i-(k < half), y_offset+half_height+k) << Config.visualizer_chars[0];
+				SetCell(i-(k < half), y_offset+half_height+k, Cell::Wave);
 		}
 		prev_point_pos = point_pos;
 	}
 }
 
+void Visualizer::SetCell(int x, int y, Cell cell)
+{
+	if (x >= 0 && y >= 0 && size_t(x) < w.getWidth() && size_t(y) < w.getHeight())
+		m_cells[y*w.getWidth()+x] = cell;
+}
+
+void Visualizer::DrawChangedCells()
+{
+	// only cells that differ from the previous frame are printed,
+	// which greatly reduces amount of data sent to the terminal.
+	const size_t width = w.getWidth();
+	for (size_t i = 0; i < m_cells.size(); ++i)
+	{
+		if (m_cells[i] == m_prev_cells[i])
+			continue;
+		w << NC::XY(i%width, i/width);
+		switch (m_cells[i])
+		{
+			case Cell::Empty:
+				w << ' ';
+				break;
+			case Cell::Wave:
+				w << Config.visualizer_chars[0];
+				break;
+			case Cell::Spectrum:
+				w << Config.visualizer_chars[1];
+				break;
+		}
+	}
+	m_prev_cells.swap(m_cells);
+	std::fill(m_cells.begin(), m_cells.end(), Cell::Empty);
+}
+
 #ifdef HAVE_FFTW3_H
-void Visualizer::DrawFrequencySpectrum(int16_t *buf, ssize_t samples, size_t y_offset, size_t height)
+void Visualizer::PlanFFT()
 {
-	for (unsigned i = 0, j = 0; i < m_samples; ++i)
+	if (m_fftw_plan)
+		return;
+	// saved wisdom may not contain plan for the current number of samples,
+	// only then it's measured and the updated wisdom is saved.
+	importWisdom();
+	m_fftw_plan = fftwf_plan_dft_r2c_1d(m_samples, m_fftw_input, m_fftw_output,
+	                                    FFTW_MEASURE | FFTW_WISDOM_ONLY);
+	if (!m_fftw_plan)
 	{
-		if (j < samples)
-			m_fftw_input[i] = buf[j++];
-		else
-			m_fftw_input[i] = 0;
+		m_fftw_plan = fftwf_plan_dft_r2c_1d(m_samples, m_fftw_input, m_fftw_output, FFTW_MEASURE);
+		exportWisdom();
 	}
+}
+
+void Visualizer::DrawFrequencySpectrum(const float *buf, ssize_t samples, size_t y_offset, size_t height)
+{
+	// loops below are kept simple so that the compiler can vectorize them
+	const unsigned n = std::min(size_t(samples), size_t(m_samples));
+	const float *window = &m_fftw_window[0];
+	for (unsigned i = 0; i < n; ++i)
+		m_fftw_input[i] = buf[i]*window[i];
+	std::fill(m_fftw_input+n, m_fftw_input+m_samples, 0.0f);
 	
-	fftw_execute(m_fftw_plan);
+	fftwf_execute(m_fftw_plan);
 	
-	// count magnitude of each frequency and scale it to fit the screen
+	float *magnitudes = &m_freq_magnitudes[0];
 	for (unsigned i = 0; i < m_fftw_results; ++i)
-		m_freq_magnitudes[i] = sqrt(m_fftw_output[i][0]*m_fftw_output[i][0] + m_fftw_output[i][1]*m_fftw_output[i][1])/1e5*height/5;
+		magnitudes[i] = m_fftw_output[i][0]*m_fftw_output[i][0] + m_fftw_output[i][1]*m_fftw_output[i][1];
 	
 	const size_t win_width = w.getWidth();
-	const int freqs_per_col = m_fftw_results/win_width /* cut bandwidth a little to achieve better look */ * 7/10;
+	if (m_freq_bins.size() != win_width)
+		GenerateFrequencyBins(win_width);
+	
+	// hann window halves the amplitude, hence the scale is twice the former
+	// one. magnitudes grow with number of samples, it was tuned for 2048.
+	const float scale = 2.0f/1e5f*height/5*2048/m_samples;
 	for (size_t i = 0; i < win_width; ++i)
 	{
-		size_t bar_height = 0;
-		for (int j = 0; j < freqs_per_col; ++j)
-			bar_height += m_freq_magnitudes[i*freqs_per_col+j];
-		bar_height = std::min(bar_height/freqs_per_col, height);
+		float sum = 0;
+		for (unsigned j = m_freq_bins[i].first; j < m_freq_bins[i].second; ++j)
+			sum += magnitudes[j];
+		// square root is taken once per column instead of once per frequency
+		float magnitude = sqrtf(sum/(m_freq_bins[i].second-m_freq_bins[i].first));
+		size_t bar_height = std::min(size_t(magnitude*scale), height);
 		const size_t start_y = y_offset > 0 ? y_offset : height-bar_height;
 		const size_t stop_y = std::min(bar_height+start_y, w.getHeight());
 		for (size_t j = start_y; j < stop_y; ++j)
-			w << NC::XY(i, j) << Config.visualizer_chars[1];
+			SetCell(i, j, Cell::Spectrum);
+	}
+}
+
+void Visualizer::GenerateFrequencyBins(size_t width)
+{
+	// columns cover logarithmically growing ranges of frequencies, so
+	// that each octave takes the same amount of space. frequencies above
+	// ~15 kHz are cut to achieve better look.
+	const double first = 1;
+	const double last = std::min(15435.0*m_samples/m_sample_rate, double(m_fftw_results));
+	const double ratio = pow(last/first, 1.0/width);
+	m_freq_bins.resize(width);
+	double lower = first;
+	for (size_t i = 0; i < width; ++i)
+	{
+		double upper = lower*ratio;
+		unsigned begin = lower, end = upper;
+		if (end <= begin)
+			end = begin+1;
+		m_freq_bins[i] = std::make_pair(begin, std::min(end, m_fftw_results));
+		lower = upper;
 	}
 }
 #endif // HAVE_FFTW3_H
@@ -205,11 +618,17 @@ void Visualizer::SetFD()
 {
 	if (m_fifo < 0 && (m_fifo = open(Config.visualizer_fifo_path.c_str(), O_RDONLY | O_NONBLOCK)) < 0)
 		Statusbar::msg("Couldn't open \"%s\" for reading PCM data: %s", Config.visualizer_fifo_path.c_str(), strerror(errno));
+	else if (!Capture::Running && !Capture::start(m_fifo, { m_sample_rate, Config.visualizer_sample_bits, Config.visualizer_float_samples, m_channels }))
+		Statusbar::msg("Couldn't start reading PCM data: %s", strerror(errno));
 }
 
 void Visualizer::ResetFD()
 {
+	Capture::stop();
+	if (m_fifo >= 0)
+		close(m_fifo);
 	m_fifo = -1;
+	m_skips = 0;
 }
 
 void Visualizer::FindOutputID()
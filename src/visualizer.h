@@ -25,6 +25,8 @@
 
 #ifdef ENABLE_VISUALIZER
 
+#include <vector>
+
 #include "interfaces.h"
 #include "screen.h"
 #include "window.h"
@@ -57,28 +59,52 @@ struct Visualizer: Screen<NC::Window>, Tabbable
 	void ResetFD();
 	void FindOutputID();
 	
-	static const int WindowTimeout;
+	/// restarts visualizer output if data from it piles up
+	/// faster than it's read. called from main loop.
+	void Sync();
 	
 protected:
 	virtual bool isLockable() OVERRIDE { return true; }
 	
 private:
-	void DrawSoundWave(int16_t *, ssize_t, size_t, size_t);
+	enum class Cell : char { Empty, Wave, Spectrum };
+	
+	void SetCell(int x, int y, Cell cell);
+	void DrawChangedCells();
+	
+	void DrawSoundWave(const float *, ssize_t, size_t, size_t);
 #	ifdef HAVE_FFTW3_H
-	void DrawFrequencySpectrum(int16_t *, ssize_t, size_t, size_t);
+	void PlanFFT();
+	void DrawFrequencySpectrum(const float *, ssize_t, size_t, size_t);
+	void GenerateFrequencyBins(size_t width);
 #	endif // HAVE_FFTW3_H
 	
 	int m_output_id;
 	timeval m_timer;
+	unsigned m_skips;
+	bool m_sync_in_progress;
 	
 	int m_fifo;
+	unsigned m_sample_rate;
+	unsigned m_channels;
+	// number of samples of each channel visualized at once
 	unsigned m_samples;
+	// interleaved samples and the ones of each channel
+	std::vector<float> m_sample_buffer;
+	std::vector<float> m_left_samples;
+	std::vector<float> m_right_samples;
+	// contents of the current and the previous frame
+	std::vector<Cell> m_cells;
+	std::vector<Cell> m_prev_cells;
 #	ifdef HAVE_FFTW3_H
 	unsigned m_fftw_results;
-	unsigned *m_freq_magnitudes;
-	double *m_fftw_input;
-	fftw_complex *m_fftw_output;
-	fftw_plan m_fftw_plan;
+	float *m_fftw_input;
+	fftwf_complex *m_fftw_output;
+	fftwf_plan m_fftw_plan;
+	std::vector<float> m_fftw_window;
+	std::vector<float> m_freq_magnitudes;
+	// first and last+1 fft result shown in each column
+	std::vector<std::pair<unsigned, unsigned>> m_freq_bins;
 #	endif // HAVE_FFTW3_H
 };
 
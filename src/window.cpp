@@ -28,6 +28,10 @@
 # include <unistd.h>
 #endif
 
+#if defined(HAVE_SYS_EPOLL_H) && !defined(USE_PDCURSES)
+# include <sys/epoll.h>
+#endif
+
 #include "error.h"
 #include "utility/string.h"
 #include "utility/wide_string.h"
@@ -86,6 +90,7 @@ Window::Window(size_t startx,
 		m_width(width),
 		m_height(height),
 		m_window_timeout(-1),
+		m_epoll_fd(-1),
 		m_color(color),
 		m_bg_color(clDefault),
 		m_base_color(color),
@@ -135,6 +140,7 @@ Window::Window(const Window &rhs)
 , m_width(rhs.m_width)
 , m_height(rhs.m_height)
 , m_window_timeout(rhs.m_window_timeout)
+, m_epoll_fd(-1)
 , m_color(rhs.m_color)
 , m_bg_color(rhs.m_bg_color)
 , m_base_color(rhs.m_base_color)
@@ -161,6 +167,7 @@ Window::Window(Window &&rhs)
 , m_width(rhs.m_width)
 , m_height(rhs.m_height)
 , m_window_timeout(rhs.m_window_timeout)
+, m_epoll_fd(rhs.m_epoll_fd)
 , m_color(rhs.m_color)
 , m_bg_color(rhs.m_bg_color)
 , m_base_color(rhs.m_base_color)
@@ -179,6 +186,7 @@ Window::Window(Window &&rhs)
 {
 	rhs.m_window = 0;
 	rhs.m_border_window = 0;
+	rhs.m_epoll_fd = -1;
 	rhs.m_history = 0;
 }
 
@@ -191,6 +199,7 @@ Window &Window::operator=(Window rhs)
 	std::swap(m_width, rhs.m_width);
 	std::swap(m_height, rhs.m_height);
 	std::swap(m_window_timeout, rhs.m_window_timeout);
+	std::swap(m_epoll_fd, rhs.m_epoll_fd);
 	std::swap(m_color, rhs.m_color);
 	std::swap(m_bg_color, rhs.m_bg_color);
 	std::swap(m_base_color, rhs.m_base_color);
@@ -214,6 +223,10 @@ Window::~Window()
 	delwin(m_window);
 	delwin(m_border_window);
 	delete m_history;
+#	if defined(HAVE_SYS_EPOLL_H) && !defined(USE_PDCURSES)
+	if (m_epoll_fd >= 0)
+		close(m_epoll_fd);
+#	endif // HAVE_SYS_EPOLL_H && !USE_PDCURSES
 }
 
 void Window::setColor(Color fg, Color bg)
@@ -410,11 +423,41 @@ void Window::setTimeout(int timeout)
 void Window::addFDCallback(int fd, void (*callback)())
 {
 	m_fds.push_back(std::make_pair(fd, callback));
+#	if defined(HAVE_SYS_EPOLL_H) && !defined(USE_PDCURSES)
+	if (m_epoll_fd >= 0)
+		epollAdd(fd);
+#	endif // HAVE_SYS_EPOLL_H && !USE_PDCURSES
+}
+
+void Window::removeFDCallback(int fd)
+{
+	for (FDCallbacks::iterator it = m_fds.begin(); it != m_fds.end();)
+	{
+		if (it->first == fd)
+			it = m_fds.erase(it);
+		else
+			++it;
+	}
+#	if defined(HAVE_SYS_EPOLL_H) && !defined(USE_PDCURSES)
+	if (m_epoll_fd >= 0)
+	{
+		epoll_event event;
+		memset(&event, 0, sizeof(event));
+		epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, &event);
+	}
+#	endif // HAVE_SYS_EPOLL_H && !USE_PDCURSES
 }
 
 void Window::clearFDCallbacksList()
 {
 	m_fds.clear();
+#	if defined(HAVE_SYS_EPOLL_H) && !defined(USE_PDCURSES)
+	// descriptors might have been closed and their numbers
+	// reused already, so the set is built from scratch later
+	if (m_epoll_fd >= 0)
+		close(m_epoll_fd);
+	m_epoll_fd = -1;
+#	endif // HAVE_SYS_EPOLL_H && !USE_PDCURSES
 }
 
 bool Window::FDCallbacksListEmpty() const
@@ -441,6 +484,39 @@ int Window::readKey()
 	// since ncmpcpp doesn't see that data arrived while waiting
 	// for input from stdin, but it seems there is no better option.
 	
+#	if defined(HAVE_SYS_EPOLL_H) && !defined(USE_PDCURSES)
+	// descriptors are registered once instead of being passed to
+	// the kernel on each call. if it fails, select is used instead.
+	if (m_epoll_fd < 0 && (m_epoll_fd = epoll_create1(EPOLL_CLOEXEC)) >= 0)
+	{
+		epollAdd(STDIN_FILENO);
+		for (FDCallbacks::const_iterator it = m_fds.begin(); it != m_fds.end(); ++it)
+			epollAdd(it->first);
+	}
+	if (m_epoll_fd >= 0)
+	{
+		epoll_event events[16];
+		int n = epoll_wait(m_epoll_fd, events, sizeof(events)/sizeof(*events), m_window_timeout);
+		result = ERR;
+		for (int i = 0; i < n; ++i)
+			if (events[i].data.fd == STDIN_FILENO)
+				result = wgetch(m_window);
+		// callbacks may modify the list, so it's searched for each event
+		for (int i = 0; i < n; ++i)
+		{
+			for (size_t j = 0; j < m_fds.size(); ++j)
+			{
+				if (m_fds[j].first == events[i].data.fd)
+				{
+					m_fds[j].second();
+					break;
+				}
+			}
+		}
+		return result;
+	}
+#	endif // HAVE_SYS_EPOLL_H && !USE_PDCURSES
+	
 	fd_set fdset;
 	FD_ZERO(&fdset);
 #	if !defined(USE_PDCURSES)
@@ -476,6 +552,17 @@ int Window::readKey()
 	return result;
 }
 
+#if defined(HAVE_SYS_EPOLL_H) && !defined(USE_PDCURSES)
+void Window::epollAdd(int fd)
+{
+	epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = fd;
+	epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+#endif // HAVE_SYS_EPOLL_H && !USE_PDCURSES
+
 void Window::pushChar(int ch)
 {
 	m_input_queue.push(ch);
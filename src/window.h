@@ -315,6 +315,10 @@ struct Window
 	/// @param callback callback
 	void addFDCallback(int fd, void (*callback)());
 	
+	/// Removes given file descriptor and its callback from the list
+	/// @param fd file descriptor
+	void removeFDCallback(int fd);
+	
 	/// Clears list of file descriptors and their callbacks
 	void clearFDCallbacksList();
 	
@@ -455,6 +459,10 @@ protected:
 	/// window timeout
 	int m_window_timeout;
 	
+	/// epoll instance that descriptors polled in ReadKey() are
+	/// registered in (if available), created when it's needed
+	int m_epoll_fd;
+	
 	/// current colors
 	Color m_color;
 	Color m_bg_color;
@@ -509,6 +517,11 @@ private:
 	typedef std::vector< std::pair<int, void (*)()> > FDCallbacks;
 	FDCallbacks m_fds;
 	
+#	if defined(HAVE_SYS_EPOLL_H) && !defined(USE_PDCURSES)
+	/// registers descriptor in epoll instance
+	void epollAdd(int fd);
+#	endif // HAVE_SYS_EPOLL_H && !USE_PDCURSES
+	
 	/// pointer to container used as history
 	std::list<std::wstring> *m_history;
 	
@@ -0,0 +1,197 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2012 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "workers.h"
+
+#ifdef HAVE_SYS_EVENTFD_H
+# include <sys/eventfd.h>
+#endif // HAVE_SYS_EVENTFD_H
+
+namespace {//
+
+const size_t MaxThreads = 4;
+
+pthread_mutex_t JobsLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t JobsAvailable = PTHREAD_COND_INITIALIZER;
+std::deque< std::function<void()> > Jobs;
+size_t Threads = 0;
+size_t IdleThreads = 0;
+
+// posted callbacks are pushed onto lock-free stack and the
+// main thread takes all of them at once.
+struct Result
+{
+	std::function<void()> Callback;
+	Result *Next;
+};
+std::atomic<Result *> Results(0);
+
+// if eventfd is not available, a pipe is used instead
+int ReadFD = -1;
+int WriteFD = -1;
+
+void initialize()
+{
+	if (ReadFD >= 0)
+		return;
+#	ifdef HAVE_SYS_EVENTFD_H
+	ReadFD = WriteFD = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#	else
+	int fds[2];
+	if (pipe(fds) == 0)
+	{
+		for (size_t i = 0; i < 2; ++i)
+		{
+			fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+			fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+		}
+		ReadFD = fds[0];
+		WriteFD = fds[1];
+	}
+#	endif // HAVE_SYS_EVENTFD_H
+	assert(ReadFD >= 0);
+}
+
+void notify()
+{
+#	ifdef HAVE_SYS_EVENTFD_H
+	uint64_t one = 1;
+#	else
+	char one = 1;
+#	endif // HAVE_SYS_EVENTFD_H
+	// if it fails, descriptor is already readable
+	// (eventfd counter/pipe buffer is full)
+	ssize_t res = write(WriteFD, &one, sizeof(one));
+	(void)res;
+}
+
+void *worker(void *)
+{
+	pthread_mutex_lock(&JobsLock);
+	while (true)
+	{
+		++IdleThreads;
+		while (Jobs.empty())
+			pthread_cond_wait(&JobsAvailable, &JobsLock);
+		--IdleThreads;
+		std::function<void()> job = std::move(Jobs.front());
+		Jobs.pop_front();
+		pthread_mutex_unlock(&JobsLock);
+		job();
+		pthread_mutex_lock(&JobsLock);
+	}
+	return 0;
+}
+
+}
+
+namespace Workers {//
+
+void run(std::function<void()> job, bool urgent)
+{
+	initialize();
+	pthread_mutex_lock(&JobsLock);
+	if (urgent)
+		Jobs.push_front(std::move(job));
+	else
+		Jobs.push_back(std::move(job));
+	// threads are created when needed and then wait for next jobs
+	if (IdleThreads < Jobs.size() && Threads < MaxThreads)
+	{
+		pthread_t t;
+		pthread_attr_t attr;
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		if (pthread_create(&t, &attr, worker, 0) == 0)
+			++Threads;
+		pthread_attr_destroy(&attr);
+	}
+	bool no_threads = Threads == 0;
+	pthread_cond_signal(&JobsAvailable);
+	pthread_mutex_unlock(&JobsLock);
+	
+	// no thread could be created, run the job here
+	if (no_threads)
+	{
+		pthread_mutex_lock(&JobsLock);
+		while (!Jobs.empty())
+		{
+			std::function<void()> waiting = std::move(Jobs.front());
+			Jobs.pop_front();
+			pthread_mutex_unlock(&JobsLock);
+			waiting();
+			pthread_mutex_lock(&JobsLock);
+		}
+		pthread_mutex_unlock(&JobsLock);
+	}
+}
+
+void post(std::function<void()> callback)
+{
+	Result *r = new Result;
+	r->Callback = std::move(callback);
+	r->Next = Results.load(std::memory_order_relaxed);
+	while (!Results.compare_exchange_weak(r->Next, r, std::memory_order_release, std::memory_order_relaxed))
+		;
+	notify();
+}
+
+int fd()
+{
+	initialize();
+	return ReadFD;
+}
+
+void processResults()
+{
+	// reset the descriptor first, so that callbacks posted
+	// after taking the list will make it readable again
+	char buf[64];
+	while (read(ReadFD, buf, sizeof(buf)) > 0)
+		;
+	Result *list = Results.exchange(0, std::memory_order_acquire);
+	// stack has the most recent callback on top
+	Result *ordered = 0;
+	while (list)
+	{
+		Result *next = list->Next;
+		list->Next = ordered;
+		ordered = list;
+		list = next;
+	}
+	while (ordered)
+	{
+		Result *next = ordered->Next;
+		ordered->Callback();
+		delete ordered;
+		ordered = next;
+	}
+}
+
+}
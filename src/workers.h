@@ -0,0 +1,48 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2012 by Andrzej Rybczak                            *
+ *   electricityispower@gmail.com                                          *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#ifndef _WORKERS_H
+#define _WORKERS_H
+
+#include <functional>
+
+/// Shared pool of threads for jobs that would block the interface (e.g.
+/// downloading lyrics). Jobs pass their results back to the main thread
+/// by posting callbacks, which are run as soon as the descriptor returned
+/// by fd() becomes readable.
+namespace Workers {//
+
+/// runs the job in one of the threads of the pool
+/// @param urgent if true, the job is run before the waiting ones
+void run(std::function<void()> job, bool urgent = false);
+
+/// schedules the callback to be run in the main thread. may
+/// be called from any thread.
+void post(std::function<void()> callback);
+
+/// @return descriptor that becomes readable if there are posted callbacks
+int fd();
+
+/// runs posted callbacks in the order they were posted
+void processResults();
+
+}
+
+#endif // _WORKERS_H